@@ -0,0 +1,182 @@
+#pragma once
+
+/** @file batch.h
+ *  @brief Processing many tokens at once.
+ */
+
+#include "jwt.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility> // std::declval
+#include <vector>
+
+#include <cstddef>
+
+namespace JWTXX
+{
+
+/** @class Span
+ *  @brief Non-owning view of a contiguous sequence, a minimal substitute for C++20 std::span.
+ */
+template <typename T>
+class Span
+{
+    public:
+        /** @brief Constructs an empty span. */
+        constexpr Span() noexcept : m_data(nullptr), m_size(0) {}
+        /** @brief Constructs a span from a pointer and a number of elements. */
+        constexpr Span(T* data, size_t size) noexcept : m_data(data), m_size(size) {}
+        /** @brief Constructs a span referring to a container with contiguous storage, like std::vector or std::array. */
+        template <typename C, typename = std::enable_if_t<std::is_convertible_v<decltype(std::declval<C&>().data()), T*>>>
+        constexpr Span(C&& container) noexcept : m_data(container.data()), m_size(container.size()) {}
+
+        /** @brief Returns a pointer to the first element. */
+        constexpr T* data() const noexcept { return m_data; }
+        /** @brief Returns the number of elements. */
+        constexpr size_t size() const noexcept { return m_size; }
+        /** @brief Checks whether the span is empty. */
+        constexpr bool empty() const noexcept { return m_size == 0; }
+        /** @brief Returns an element by index. */
+        constexpr T& operator[](size_t index) const noexcept { return m_data[index]; }
+        /** @brief Returns an iterator to the first element. */
+        constexpr T* begin() const noexcept { return m_data; }
+        /** @brief Returns an iterator past the last element. */
+        constexpr T* end() const noexcept { return m_data + m_size; }
+
+    private:
+        T* m_data;
+        size_t m_size;
+};
+
+/** @class Executor
+ *  @brief Runs a batch of independent tasks, an adapter for an existing thread pool.
+ */
+class Executor
+{
+    public:
+        /** @typedef Task
+         *  @brief Processes items with indexes in [begin, end).
+         */
+        using Task = std::function<void (size_t begin, size_t end)>;
+
+        /** @brief Destructor. */
+        virtual ~Executor() = default;
+
+        /** @brief Calls the task for non-overlapping ranges that together cover [0, count), possibly in parallel.
+         *  Returns when all ranges are processed.
+         *  @param count number of items;
+         *  @param task the task.
+         *  @throws any exception thrown by the task.
+         */
+        virtual void run(size_t count, const Task& task) = 0;
+};
+
+/** @class ThreadPoolExecutor
+ *  @brief Work-stealing executor with a fixed set of threads.
+ *  Each batch is split between the threads evenly, threads that run out of work take items from the others.
+ *  The calling thread takes part in the work. The threads are kept between batches,
+ *  so their per-thread crypto contexts stay warm.
+ */
+class ThreadPoolExecutor : public Executor
+{
+    public:
+        /** @brief Constructs an executor.
+         *  @param threads number of threads working on a batch, including the calling one; 0 means the number of CPU cores.
+         */
+        explicit ThreadPoolExecutor(size_t threads = 0);
+        /** @brief Destructor, waits for the threads to finish. */
+        ~ThreadPoolExecutor() override;
+
+        ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+        ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+        /** @brief Returns the number of threads working on a batch, including the calling one. */
+        size_t threads() const noexcept;
+
+        /** @brief Runs a batch. Batches from different threads are run one after another,
+         *  batches started from inside a task are run by the calling thread.
+         *  @param count number of items;
+         *  @param task the task.
+         *  @throws the first exception thrown by the task.
+         */
+        void run(size_t count, const Task& task) override;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+};
+
+/** @fn Executor& defaultExecutor()
+ *  @brief Returns a process-wide ThreadPoolExecutor using all CPU cores, created on first use.
+ */
+Executor& defaultExecutor();
+
+/** @fn std::vector<ValidationResult> verifyBatch(Span<const std::string_view> tokens, const Key& key, const ValidatorSet& validators, Executor& executor)
+ *  @brief Validates a batch of tokens.
+ *  @param tokens the tokens;
+ *  @param key key to use for signature verification;
+ *  @param validators a list of validators, called concurrently;
+ *  @param executor executor for the batch.
+ *  @return a result for each token, in the same order.
+ *  @throws Key::Error if the key can't be loaded.
+ */
+std::vector<ValidationResult> verifyBatch(Span<const std::string_view> tokens, const Key& key, const ValidatorSet& validators, Executor& executor);
+
+/** @fn std::vector<ValidationResult> verifyBatch(Span<const std::string_view> tokens, const Key& key, const ValidatorSet& validators = ValidatorSet::defaults())
+ *  @brief Validates a batch of tokens using the default executor.
+ *  @param tokens the tokens;
+ *  @param key key to use for signature verification;
+ *  @param validators an optional list of validators, called concurrently; validates 'exp' by default.
+ *  @return a result for each token, in the same order.
+ *  @throws Key::Error if the key can't be loaded.
+ */
+std::vector<ValidationResult> verifyBatch(Span<const std::string_view> tokens, const Key& key, const ValidatorSet& validators = ValidatorSet::defaults());
+
+/** @class TokenBatch
+ *  @brief Signed tokens stored back to back in a single buffer.
+ */
+class TokenBatch
+{
+    public:
+        /** @brief Returns the number of tokens. */
+        size_t size() const noexcept { return m_offsets.size() - 1; }
+        /** @brief Checks whether the batch is empty. */
+        bool empty() const noexcept { return size() == 0; }
+        /** @brief Returns a token by index, valid while the batch exists. */
+        std::string_view operator[](size_t index) const noexcept { return std::string_view(m_data).substr(m_offsets[index], m_offsets[index + 1] - m_offsets[index]); }
+        /** @brief Returns all tokens without separators. */
+        const std::string& data() const noexcept { return m_data; }
+
+    private:
+        std::string m_data;
+        std::vector<size_t> m_offsets{0};
+
+        friend TokenBatch signBatch(Span<const Value::Object> claims, const Key& key, Executor& executor, const Value::Object& header);
+};
+
+/** @fn TokenBatch signBatch(Span<const Value::Object> claims, const Key& key, Executor& executor, const Value::Object& header = Value::Object{})
+ *  @brief Signs a batch of tokens sharing the same header.
+ *  The header is serialized once, the results are collected in a single buffer.
+ *  @param claims a list of claims for each token;
+ *  @param key key to use for signing;
+ *  @param executor executor for the batch;
+ *  @param header optional header records shared by all tokens; 'alg' and 'typ' can't be specified manually.
+ *  @return tokens in the same order as the claims.
+ *  @throws Key::Error
+ */
+TokenBatch signBatch(Span<const Value::Object> claims, const Key& key, Executor& executor, const Value::Object& header = Value::Object{});
+
+/** @fn TokenBatch signBatch(Span<const Value::Object> claims, const Key& key)
+ *  @brief Signs a batch of tokens using the default executor.
+ *  @param claims a list of claims for each token;
+ *  @param key key to use for signing.
+ *  @return tokens in the same order as the claims.
+ *  @throws Key::Error
+ */
+TokenBatch signBatch(Span<const Value::Object> claims, const Key& key);
+
+}
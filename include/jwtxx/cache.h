@@ -0,0 +1,70 @@
+#pragma once
+
+/** @file cache.h
+ *  @brief Caching of verified tokens.
+ */
+
+#include "jwt.h"
+
+#include <memory>
+#include <string_view>
+
+#include <cstddef>
+
+namespace JWTXX
+{
+
+/** @class VerifiedTokenCache
+ *  @brief Remembers tokens with valid signatures, so a repeated token is not verified again.
+ *  Tokens are identified by their bytes and the verification key. Validators of the verifier
+ *  run on every call, hits only skip parsing and signature verification.
+ *  Only tokens with an integer 'exp' claim are cached, entries are dropped when the token expires
+ *  or, least recently used first, when the cache exceeds its memory budget.
+ *  The cache is split into independently locked shards and can be used by many threads at once.
+ */
+class VerifiedTokenCache
+{
+    public:
+        /** @brief Constructs a cache.
+         *  @param memoryBudget approximate limit for the memory used by the entries, in bytes;
+         *  @param shards number of independently locked parts, 0 means a default suitable for most servers.
+         */
+        explicit VerifiedTokenCache(size_t memoryBudget = 16 * 1024 * 1024, size_t shards = 0);
+        /** @brief Destructor. */
+        ~VerifiedTokenCache();
+
+        VerifiedTokenCache(const VerifiedTokenCache&) = delete;
+        VerifiedTokenCache& operator=(const VerifiedTokenCache&) = delete;
+
+        /** @brief Validates a token, verifying its signature only if it is not in the cache.
+         *  @param token the token;
+         *  @param verifier verifier for the token, its key identifies the cached entries.
+         */
+        ValidationResult verify(std::string_view token, const Verifier& verifier) noexcept;
+
+        /** @brief Validates a token and returns its JWT, verifying the signature only if it is not in the cache.
+         *  @param token the token;
+         *  @param verifier verifier for the token, its key identifies the cached entries.
+         *  @throws JWT::ParseError
+         *  @throws JWT::ValidationError
+         */
+        JWT decode(std::string_view token, const Verifier& verifier);
+
+        /** @brief Removes all entries. Counters are kept. */
+        void clear() noexcept;
+
+        /** @brief Returns the number of calls that skipped signature verification. */
+        size_t hits() const noexcept;
+        /** @brief Returns the number of calls that verified a signature. */
+        size_t misses() const noexcept;
+        /** @brief Returns the number of cached tokens. */
+        size_t size() const noexcept;
+        /** @brief Returns the approximate memory used by the entries, in bytes. */
+        size_t memoryUsage() const noexcept;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+};
+
+}
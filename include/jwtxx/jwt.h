@@ -7,13 +7,23 @@
 #include "value.h"
 #include "error.h"
 
+#include <array>
 #include <functional>
+#include <initializer_list>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <utility> // std::move
 
+#include <cstddef>
+#include <cstdint>
 #include <ctime>
 
+// OpenSSL 3 library context, the same declaration as in <openssl/types.h>.
+typedef struct ossl_lib_ctx_st OSSL_LIB_CTX;
+
 /** @namespace JWTXX
  *  @brief All classes, functions and constants are here.
  */
@@ -61,6 +71,9 @@ Algorithm stringToAlg(const std::string& value);
 /** @class Key
  *  @brief Represents signature algorithm
  *  Signs tokens and verifies token signatures.
+ *  A single key can be used by any number of threads at once: sign() and verify() don't modify shared state,
+ *  key files are loaded once on first use, or in the constructor if the usage is given.
+ *  The password callback may be called from any of these threads.
  */
 class Key
 {
@@ -85,12 +98,75 @@ class Key
          */
         static std::string noPasswordCallback();
 
+        /** @class LibraryContext
+         *  @brief Where OpenSSL 3 fetches algorithm implementations and key decoders from.
+         *  Lets a service isolate its provider configuration. Algorithms are fetched when a key is loaded, never per token.
+         */
+        struct LibraryContext
+        {
+            /** @brief OpenSSL library context, nullptr for the default one. */
+            OSSL_LIB_CTX* libCtx = nullptr;
+            /** @brief Property query, e.g. "provider=fips", empty for none. */
+            std::string propertyQuery;
+        };
+
+        /** @enum Usage
+         *  @brief What a key is for. Keys constructed with a usage load everything it needs right away.
+         */
+        enum class Usage {
+            Signing,     /**< signs tokens, needs a private key */
+            Verification /**< verifies tokens, needs a public key or a certificate */
+        };
+
         /** @brief Constructs key using the specified algorithm and data.
          *  @param alg signature algorithm;
          *  @param keyData a shared secret, a path to a key file or PEM data for public keys;
          *  @param cb password callabck for password-protected keys.
          */
         Key(Algorithm alg, const std::string& keyData, const PasswordCallback& cb = noPasswordCallback);
+        /** @brief Constructs key using the specified algorithm, data and OpenSSL library context.
+         *  @param alg signature algorithm;
+         *  @param keyData a shared secret, a path to a key file or PEM data for public keys;
+         *  @param context library context and property query;
+         *  @param cb password callabck for password-protected keys.
+         *  @throws Error if the context is not empty and OpenSSL is older than 3.0.
+         */
+        Key(Algorithm alg, const std::string& keyData, const LibraryContext& context, const PasswordCallback& cb = noPasswordCallback);
+        /** @brief Constructs key and loads it for the specified usage, so a broken key fails here rather than on the first token.
+         *  @param alg signature algorithm;
+         *  @param keyData a shared secret, a path to a key file or PEM data for public keys;
+         *  @param usage what the key is for;
+         *  @param cb password callabck for password-protected keys.
+         *  @throws Error
+         */
+        Key(Algorithm alg, const std::string& keyData, Usage usage, const PasswordCallback& cb = noPasswordCallback);
+        /** @brief Constructs key using the specified OpenSSL library context and loads it for the specified usage.
+         *  @param alg signature algorithm;
+         *  @param keyData a shared secret, a path to a key file or PEM data for public keys;
+         *  @param context library context and property query;
+         *  @param usage what the key is for;
+         *  @param cb password callabck for password-protected keys.
+         *  @throws Error
+         */
+        Key(Algorithm alg, const std::string& keyData, const LibraryContext& context, Usage usage, const PasswordCallback& cb = noPasswordCallback);
+        /** @brief Constructs key from key data in memory, without touching the filesystem.
+         *  Asymmetric keys are accepted in PEM or DER: PKCS#8 or traditional private keys, SubjectPublicKeyInfo public keys and X.509 certificates.
+         *  The format is recognized by the data itself, the key is parsed right away and the data is not kept.
+         *  A private key both signs and verifies. For HMAC keys the data is the shared secret.
+         *  @param alg signature algorithm;
+         *  @param keyData key data;
+         *  @param cb password callabck for password-protected keys.
+         *  @throws Error
+         */
+        static Key fromMemory(Algorithm alg, std::string_view keyData, const PasswordCallback& cb = noPasswordCallback);
+        /** @brief Constructs key from key data in memory using the specified OpenSSL library context.
+         *  @param alg signature algorithm;
+         *  @param keyData key data;
+         *  @param context library context and property query;
+         *  @param cb password callabck for password-protected keys.
+         *  @throws Error
+         */
+        static Key fromMemory(Algorithm alg, std::string_view keyData, const LibraryContext& context, const PasswordCallback& cb = noPasswordCallback);
         /** @brief Destructor. */
         ~Key();
 
@@ -113,40 +189,156 @@ class Key
          *  @param signature a signature to verify.
          *  @throws Error
          */
-        bool verify(const void* data, size_t size, const std::string& signature) const;
+        bool verify(const void* data, size_t size, std::string_view signature) const;
 
         /** @class */
         struct Impl;
     private:
         Algorithm m_alg;
         std::unique_ptr<Impl> m_impl;
+        // Keys constructed without a usage are warmed up for verification.
+        Usage m_usage = Usage::Verification;
+
+        Key(Algorithm alg, Impl* impl) noexcept;
+
+        friend class Verifier;
+        friend class VerifiedTokenCache;
+        friend void warmUp(const Key& key);
+};
+
+/** @fn void warmUp(const Key& key)
+ *  @brief Does the work of the first sign() or verify() in advance, before a process starts taking traffic.
+ *  Loads the key, fetches the digest and puts a digest context into the pool of the calling thread.
+ *  Keys constructed without a usage are prepared for verification, like Verifier does.
+ *  Context pools are per thread, call it from each worker thread to warm all of them.
+ *  @param key the key.
+ *  @throws Key::Error
+ */
+void warmUp(const Key& key);
+
+/** @brief Warms up several keys, see warmUp(const Key&).
+ *  @param key the first key;
+ *  @param keys the rest of the keys.
+ *  @throws Key::Error
+ */
+template <typename... Keys>
+void warmUp(const Key& key, const Keys&... keys)
+{
+    warmUp(key);
+    (warmUp(keys), ...);
+}
+
+
+/** @class TokenView
+ *  @brief Non-owning view of the parts of a serialized token.
+ *  Refers to the token string, which must outlive the view. Parts are base64url-encoded.
+ */
+class TokenView
+{
+    public:
+        /** @brief Splits a token into parts without copying.
+         *  @param token the token.
+         *  @throws JWT::ParseError
+         */
+        explicit TokenView(std::string_view token);
+
+        /** @brief Returns the encoded header. */
+        std::string_view header() const noexcept { return m_header; }
+        /** @brief Returns the encoded claims. */
+        std::string_view claims() const noexcept { return m_claims; }
+        /** @brief Returns the encoded signature, empty for unsigned tokens. */
+        std::string_view signature() const noexcept { return m_signature; }
+        /** @brief Returns the signed part of the token: header and claims with a dot between them. */
+        std::string_view signingInput() const noexcept { return m_signingInput; }
+
+    private:
+        std::string_view m_header;
+        std::string_view m_claims;
+        std::string_view m_signature;
+        std::string_view m_signingInput;
+};
+
+
+/** @enum ErrorCode
+ *  @brief Reasons to reject a token.
+ */
+enum class ErrorCode {
+    Ok,                /**< no error */
+    InvalidStructure,  /**< the token is not made of dot-separated parts */
+    InvalidEncoding,   /**< the header or the claims are not valid base64url */
+    InvalidJSON,       /**< the header or the claims are not a JSON object */
+    InvalidAlgorithm,  /**< 'alg' is not a string or not a known algorithm */
+    AlgorithmMismatch, /**< 'alg' differs from the key algorithm */
+    InvalidSignature,  /**< the signature doesn't match */
+    Expired,           /**< 'exp' is in the past */
+    NotYetValid,       /**< 'nbf' is in the future */
+    NotYetIssued,      /**< 'iat' is in the future */
+    InvalidTime,       /**< a time claim is not an integer */
+    InvalidClaim,      /**< 'iss', 'aud' or 'sub' has an unexpected value */
+    ValidationFailed,  /**< a custom validator rejected the claims */
+    KeyError,          /**< the key can't be used, e.g. it can't be loaded */
+    LimitExceeded,     /**< the token is too long or its JSON is nested too deep or has too many values */
+    UnknownKey,        /**< no key for the 'kid' and 'alg' of the token */
+    AlgorithmNotAllowed /**< 'alg' is not among the accepted algorithms */
 };
 
+/** @struct Limits
+ *  @brief Limits for untrusted tokens.
+ *  Lengths are checked before anything is decoded, depth and the number of values while the JSON is parsed,
+ *  so an oversized token costs neither memory nor time proportional to its size.
+ */
+struct Limits
+{
+    size_t maxTokenSize = 64 * 1024;   /**< the maximum length of a token, in bytes */
+    size_t maxSegmentSize = 32 * 1024; /**< the maximum length of the encoded header, claims or signature, in bytes */
+    size_t maxDepth = 64;              /**< the maximum nesting of arrays and objects in the header or the claims, the top-level object is 1 */
+    size_t maxMembers = 1024;          /**< the maximum number of values in the header or the claims, nested ones included */
+};
 
 /** @class ValidationResult
- *  @brief Represents the result of validation. If validation is successfull an object of this class is equivalent to 'true' boolean value. Otherwise it is equivalent ot 'false' and contains an error message.
+ *  @brief Represents the result of validation. If validation is successfull an object of this class is equivalent to 'true' boolean value. Otherwise it is equivalent ot 'false' and contains an error code and message.
  */
 class ValidationResult
 {
     public:
         /** @brief 'Success' constructor. */
         static ValidationResult ok() noexcept { return ValidationResult(); }
+        /** @brief 'Failure' constructor, the code is ErrorCode::ValidationFailed.
+         *  @param message error message.
+         */
+        static ValidationResult failure(const std::string& message) noexcept { return ValidationResult(ErrorCode::ValidationFailed, message); }
         /** @brief 'Failure' constructor.
+         *  @param code error code;
          *  @param message error message.
          */
-        static ValidationResult failure(const std::string& message) noexcept { return ValidationResult(message); }
+        static ValidationResult failure(ErrorCode code, const std::string& message) noexcept { return ValidationResult(code, message); }
 
         /** @brief Cast operator to bool. */
-        explicit operator bool() const noexcept { return m_message.empty(); }
+        explicit operator bool() const noexcept { return m_code == ErrorCode::Ok; }
 
-        /** @brief Error message accessor. */
-        const std::string& message() const noexcept { return m_message; }
+        /** @brief Error code accessor. */
+        ErrorCode code() const noexcept { return m_code; }
+
+        /** @brief Error message accessor, the message is formatted on each call. */
+        std::string message() const;
 
     private:
+        ErrorCode m_code = ErrorCode::Ok;
         std::string m_message;
+        // Details of failures found by the library, the message is formatted from them on request.
+        // Which ones are used depends on the code; none if m_name is not set, m_message is the message then.
+        const char* m_name = nullptr; // the claim, the token part or the header record, a string literal
+        Algorithm m_expected = Algorithm::none;
+        Algorithm m_actual = Algorithm::none;
+        int64_t m_value = 0; // the time of the claim or the size of the part
+        int64_t m_bound = 0; // the current time or the size limit
+        std::string m_text; // the key id, the expected claim value or the algorithm name
+        Value m_claim; // the actual claim value
 
         ValidationResult() noexcept {}
-        explicit ValidationResult(const std::string& message) noexcept : m_message(message) {}
+        ValidationResult(ErrorCode code, const std::string& message) noexcept : m_code(code), m_message(message) {}
+
+        friend struct FailureDetails;
 };
 
 /** @typedef Validator
@@ -198,6 +390,119 @@ Validator sub(std::string subject) noexcept;
 
 }
 
+/** @typedef Clock
+ *  @brief Returns the current time, in seconds since the epoch.
+ */
+using Clock = std::function<std::time_t ()>;
+
+/** @fn std::time_t coarseTime()
+ *  @brief Returns the current time from a clock that is cheaper to read than std::time(),
+ *  CLOCK_REALTIME_COARSE where available. Its resolution of a few milliseconds is more than enough for time claims.
+ */
+std::time_t coarseTime() noexcept;
+
+/** @class ValidatorSet
+ *  @brief Claim checks built once and reused for any number of tokens.
+ *  Standard checks find their claims in a single pass over the claims and run in a fixed order:
+ *  'exp', 'nbf', 'iat', 'iss', 'aud', 'sub'; custom validators run after them, in the order they are added.
+ *  Like the functions in JWTXX::Validate, standard checks accept tokens without the claim.
+ *  Checks against the current time read it from a clock on each call, coarseTime() by default,
+ *  so a set built once stays valid forever.
+ *  A set can be used by many threads at once if its clock and custom validators can.
+ */
+class ValidatorSet
+{
+    public:
+        /** @brief Constructs an empty set, accepting any claims. */
+        ValidatorSet() = default;
+        /** @brief Constructs a set of custom validators.
+         *  @param validators a list of validators.
+         */
+        ValidatorSet(std::initializer_list<Validator> validators);
+        /** @brief Constructs a set of custom validators.
+         *  @param validators a list of validators.
+         */
+        ValidatorSet(Validators validators) noexcept;
+
+        /** @brief Returns a set validating 'exp' against the current time of each call, the default for token verification. */
+        static const ValidatorSet& defaults() noexcept;
+
+        /** @brief Validates 'exp' against the current time of each call, read from the clock. */
+        ValidatorSet& exp() noexcept;
+        /** @brief Validates 'exp' against a fixed time.
+         *  @param now the time.
+         */
+        ValidatorSet& exp(std::time_t now) noexcept;
+        /** @brief Validates 'nbf' against the current time of each call, read from the clock. */
+        ValidatorSet& nbf() noexcept;
+        /** @brief Validates 'nbf' against a fixed time.
+         *  @param now the time.
+         */
+        ValidatorSet& nbf(std::time_t now) noexcept;
+        /** @brief Validates 'iat' against the current time of each call, read from the clock. */
+        ValidatorSet& iat() noexcept;
+        /** @brief Validates 'iat' against a fixed time.
+         *  @param now the time.
+         */
+        ValidatorSet& iat(std::time_t now) noexcept;
+        /** @brief Validates 'iss'.
+         *  @param issuer valid issuer name.
+         */
+        ValidatorSet& iss(std::string issuer) noexcept;
+        /** @brief Validates 'aud'.
+         *  @param audience valid audience.
+         */
+        ValidatorSet& aud(std::string audience) noexcept;
+        /** @brief Validates 'sub'.
+         *  @param subject valid subject name.
+         */
+        ValidatorSet& sub(std::string subject) noexcept;
+        /** @brief Sets the clock for the checks against the current time.
+         *  @param clock the clock, called at most once per validation.
+         */
+        ValidatorSet& clock(Clock clock) noexcept;
+        /** @brief Allows for clock skew between the issuer and the verifier.
+         *  Applies to 'exp', 'nbf' and 'iat', both against the current and a fixed time.
+         *  @param seconds the allowed skew.
+         */
+        ValidatorSet& leeway(std::time_t seconds) noexcept;
+        /** @brief Adds a custom validator.
+         *  @param validator the validator.
+         */
+        ValidatorSet& add(Validator validator);
+
+        /** @brief Runs all checks, stops at the first failure.
+         *  @param claims the claims.
+         */
+        ValidationResult validate(const Value::Object& claims) const;
+
+    private:
+        // Standard claims, also bit numbers in the mask of enabled checks.
+        enum Claim { Exp, Nbf, Iat, Iss, Aud, Sub, ClaimCount };
+
+        struct TimeCheck
+        {
+            bool currentTime = false;
+            std::time_t now = 0;
+        };
+
+        unsigned m_checks = 0;
+        std::array<TimeCheck, 3> m_times; // 'exp', 'nbf', 'iat'
+        std::array<std::string, 3> m_values; // 'iss', 'aud', 'sub'
+        Clock m_clock; // coarseTime() if empty.
+        std::time_t m_leeway = 0;
+
+        Validators m_custom;
+
+        ValidatorSet& time(Claim claim, bool currentTime, std::time_t now) noexcept;
+        ValidatorSet& value(Claim claim, std::string&& value) noexcept;
+};
+
+class DecodeResult;
+class KeySet;
+class KeyRegistry;
+class KeyStore;
+
 /** @class JWT
  *  @brief Main class to work with JWT
  */
@@ -238,11 +543,12 @@ class JWT
         };
 
         /** @brief Constructs a JWT from a token.
+         *  The token is checked against the default Limits.
          *  @param token the token;
          *  @param key key to use for signatire verification;
          *  @param validators an optional list of validators; validates 'exp' by default.
          */
-        JWT(const std::string& token, Key key, Validators validators = {Validate::exp()});
+        JWT(std::string_view token, Key key, const ValidatorSet& validators = ValidatorSet::defaults());
 
         /** @brief Constructs a JWT from scratch.
          *  @param alg signature algorithm;
@@ -252,16 +558,78 @@ class JWT
         JWT(Algorithm alg, Value::Object claims, Value::Object header = Value::Object{}) noexcept;
 
         /** @brief Returns a JWT for a token without validation.
-         *  @param token the token.
+         *  @param token the token;
+         *  @param limits limits for the size and the structure of the token.
          */
-        static JWT parse(const std::string& token);
+        static JWT parse(std::string_view token, const Limits& limits = Limits{});
 
         /** @brief Validates a token without constructing a JWT.
+         *  The token is checked against the default Limits.
          *  @param token the token;
          *  @param key key to use for signatire verification;
          *  @param validators an optional list of validators; validates 'exp' by default.
          */
-        static ValidationResult verify(const std::string& token, Key key, Validators validators = {Validate::exp()}) noexcept;
+        static ValidationResult verify(std::string_view token, Key key, const ValidatorSet& validators = ValidatorSet::defaults()) noexcept;
+
+        /** @brief Validates a token and returns its JWT or the reason of rejection, without throwing exceptions.
+         *  Error messages are formatted only when requested with DecodeResult::message().
+         *  @param token the token;
+         *  @param key key to use for signature verification;
+         *  @param validators an optional list of validators; validates 'exp' by default;
+         *  @param limits limits for the size and the structure of the token.
+         */
+        static DecodeResult tryDecode(std::string_view token, const Key& key, const ValidatorSet& validators = ValidatorSet::defaults(), const Limits& limits = Limits{}) noexcept;
+
+        /** @brief Validates a token with the key of a key set picked by the 'kid' and the 'alg' of the token.
+         *  The token is checked against the default Limits.
+         *  @param token the token;
+         *  @param keys the key set;
+         *  @param validators an optional list of validators; validates 'exp' by default.
+         */
+        static ValidationResult verify(std::string_view token, const KeySet& keys, const ValidatorSet& validators = ValidatorSet::defaults()) noexcept;
+
+        /** @brief Validates a token with the key of a key set picked by the 'kid' and the 'alg' of the token,
+         *  returns its JWT or the reason of rejection.
+         *  @param token the token;
+         *  @param keys the key set;
+         *  @param validators an optional list of validators; validates 'exp' by default;
+         *  @param limits limits for the size and the structure of the token.
+         */
+        static DecodeResult tryDecode(std::string_view token, const KeySet& keys, const ValidatorSet& validators = ValidatorSet::defaults(), const Limits& limits = Limits{}) noexcept;
+
+        /** @brief Validates a token with the key of a registry picked by the 'kid' and the 'alg' of the token.
+         *  The token is checked against the default Limits.
+         *  @param token the token;
+         *  @param keys the registry;
+         *  @param validators an optional list of validators; validates 'exp' by default.
+         */
+        static ValidationResult verify(std::string_view token, const KeyRegistry& keys, const ValidatorSet& validators = ValidatorSet::defaults()) noexcept;
+
+        /** @brief Validates a token with the key of a registry picked by the 'kid' and the 'alg' of the token,
+         *  returns its JWT or the reason of rejection.
+         *  @param token the token;
+         *  @param keys the registry;
+         *  @param validators an optional list of validators; validates 'exp' by default;
+         *  @param limits limits for the size and the structure of the token.
+         */
+        static DecodeResult tryDecode(std::string_view token, const KeyRegistry& keys, const ValidatorSet& validators = ValidatorSet::defaults(), const Limits& limits = Limits{}) noexcept;
+
+        /** @brief Validates a token with the key of a key store picked by the 'kid' and the 'alg' of the token.
+         *  The token is checked against the default Limits.
+         *  @param token the token;
+         *  @param keys the key store;
+         *  @param validators an optional list of validators; validates 'exp' by default.
+         */
+        static ValidationResult verify(std::string_view token, const KeyStore& keys, const ValidatorSet& validators = ValidatorSet::defaults()) noexcept;
+
+        /** @brief Validates a token with the key of a key store picked by the 'kid' and the 'alg' of the token,
+         *  returns its JWT or the reason of rejection.
+         *  @param token the token;
+         *  @param keys the key store;
+         *  @param validators an optional list of validators; validates 'exp' by default;
+         *  @param limits limits for the size and the structure of the token.
+         */
+        static DecodeResult tryDecode(std::string_view token, const KeyStore& keys, const ValidatorSet& validators = ValidatorSet::defaults(), const Limits& limits = Limits{}) noexcept;
 
         /** @brief Returns an algorithm. */
         Algorithm alg() const noexcept { return m_alg; }
@@ -297,6 +665,128 @@ class JWT
         Algorithm m_alg;
         Value::Object m_header;
         Value::Object m_claims;
+
+        template <typename Keys>
+        static DecodeResult decodeWith(std::string_view token, const Keys& keys, const ValidatorSet& validators, const Limits& limits) noexcept;
+
+        friend class Verifier;
+};
+
+/** @class DecodeResult
+ *  @brief Either a verified JWT or the reason why a token is rejected.
+ */
+class DecodeResult
+{
+    public:
+        /** @brief Checks whether the token is accepted. */
+        explicit operator bool() const noexcept { return m_result.code() == ErrorCode::Ok; }
+
+        /** @brief Returns the error code, ErrorCode::Ok for accepted tokens. */
+        ErrorCode code() const noexcept { return m_result.code(); }
+
+        /** @brief Returns the error message, formatted on each call; empty for accepted tokens. */
+        std::string message() const { return m_result.message(); }
+
+        /** @brief Returns the JWT.
+         *  @throws JWT::ParseError or JWT::ValidationError with the error message if the token is rejected.
+         */
+        const JWT& jwt() const&;
+        /** @brief Returns the JWT.
+         *  @throws JWT::ParseError or JWT::ValidationError with the error message if the token is rejected.
+         */
+        JWT&& jwt() &&;
+
+    private:
+        std::optional<JWT> m_jwt;
+        // The reason of rejection, its message is formatted on request.
+        ValidationResult m_result = ValidationResult::ok();
+
+        explicit DecodeResult(JWT&& jwt) noexcept : m_jwt(std::move(jwt)) {}
+        explicit DecodeResult(ValidationResult&& failure) noexcept : m_result(std::move(failure)) {}
+
+        friend class JWT;
+        friend class Verifier;
+        friend class VerifiedTokenCache;
+};
+
+/** @enum ValidationOrder
+ *  @brief When validators run relative to signature verification.
+ */
+enum class ValidationOrder {
+    SignatureFirst, /**< verify the signature, then run the validators */
+    ClaimsFirst     /**< run the validators on the claims before verifying the signature, so stale or misdirected tokens are rejected without public-key operations */
+};
+
+/** @class Verifier
+ *  @brief Verifies and decodes tokens using a key and a list of validators given once.
+ *  Loads the verification key on construction, so each call does only per-token work.
+ *  A verifier can be used by many threads at once if its validators can.
+ */
+class Verifier
+{
+    public:
+        /** @brief Constructs a verifier that validates 'exp' against the current time of each call.
+         *  @param key key to use for signature verification, must outlive the verifier.
+         *  @throws Key::Error
+         */
+        explicit Verifier(const Key& key);
+        /** @brief Constructs a verifier.
+         *  @param key key to use for signature verification, must outlive the verifier;
+         *  @param validators a list of validators;
+         *  @param order when the validators run; with ValidationOrder::ClaimsFirst they see claims of tokens that are not verified yet,
+         *  but claims are never returned unless the signature is valid;
+         *  @param limits limits for the size and the structure of tokens.
+         *  @note Validate::exp() and the like capture the time when they are created, which becomes stale in a long-living verifier;
+         *  ValidatorSet::exp() and the like read the time on each call.
+         *  @throws Key::Error
+         */
+        Verifier(const Key& key, ValidatorSet validators, ValidationOrder order = ValidationOrder::SignatureFirst, const Limits& limits = Limits{});
+        /** @brief Constructs a verifier that shares ownership of the key and validates 'exp' against the current time of each call.
+         *  @param key key to use for signature verification.
+         *  @throws Key::Error
+         */
+        explicit Verifier(std::shared_ptr<const Key> key);
+        /** @brief Constructs a verifier that shares ownership of the key.
+         *  @param key key to use for signature verification;
+         *  @param validators a list of validators;
+         *  @param order when the validators run;
+         *  @param limits limits for the size and the structure of tokens.
+         *  @throws Key::Error
+         */
+        Verifier(std::shared_ptr<const Key> key, ValidatorSet validators, ValidationOrder order = ValidationOrder::SignatureFirst, const Limits& limits = Limits{});
+
+        /** @brief Deleted, a temporary key would not outlive the verifier. */
+        explicit Verifier(Key&&) = delete;
+        /** @brief Deleted, a temporary key would not outlive the verifier. */
+        Verifier(Key&&, ValidatorSet, ValidationOrder = ValidationOrder::SignatureFirst, const Limits& = Limits{}) = delete;
+
+        /** @brief Returns the key. */
+        const Key& key() const noexcept { return *m_key; }
+
+        /** @brief Validates a token.
+         *  @param token the token.
+         */
+        ValidationResult verify(std::string_view token) const noexcept;
+
+        /** @brief Validates a token and returns its JWT.
+         *  @param token the token.
+         *  @throws JWT::ParseError
+         *  @throws JWT::ValidationError
+         */
+        JWT decode(std::string_view token) const;
+
+        /** @brief Validates a token and returns its JWT or the reason of rejection, without throwing exceptions.
+         *  @param token the token.
+         */
+        DecodeResult tryDecode(std::string_view token) const noexcept;
+
+    private:
+        std::shared_ptr<const Key> m_key;
+        ValidatorSet m_validators;
+        ValidationOrder m_order;
+        Limits m_limits;
+
+        friend class VerifiedTokenCache;
 };
 
 }
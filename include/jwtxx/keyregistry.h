@@ -0,0 +1,115 @@
+#pragma once
+
+/** @file keyregistry.h
+ *  @brief Keys for several algorithms at once.
+ */
+
+#include "jwt.h"
+
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace JWTXX
+{
+
+/** @class KeyRegistry
+ *  @brief Keys indexed by their ids ('kid') and algorithms.
+ *  A token is parsed once and checked with the key for the 'kid' and the 'alg' of its header, so tokens signed
+ *  with different algorithms, e.g. during a migration from HS256 to RS256, are verified by a single call.
+ *  Only the algorithms of the allow-list are accepted.
+ *  Lookups never lock and can run in any number of threads while keys are added or removed.
+ */
+class KeyRegistry
+{
+    public:
+        /** @class Lease
+         *  @brief A key found in the registry.
+         *  The key stays valid while the lease exists, even if it is removed from the registry.
+         *  @note Don't add or remove keys in the thread that holds a lease, this waits for the lease to end.
+         */
+        class Lease
+        {
+            public:
+                /** @brief Move constructor. */
+                Lease(Lease&& rhs) noexcept;
+                /** @brief Destructor. */
+                ~Lease();
+
+                Lease(const Lease&) = delete;
+                Lease& operator=(const Lease&) = delete;
+                Lease& operator=(Lease&&) = delete;
+
+                /** @brief Checks whether the key was found. */
+                explicit operator bool() const noexcept { return m_key != nullptr; }
+
+                /** @brief Returns the key. */
+                const Key& operator*() const noexcept { return *m_key; }
+                /** @brief Returns the key. */
+                const Key* operator->() const noexcept { return m_key; }
+
+            private:
+                friend class KeyRegistry;
+                friend class KeyStore;
+
+                std::atomic<size_t>* m_count;
+                const Key* m_key;
+
+                Lease(std::atomic<size_t>* count, const Key* key) noexcept : m_count(count), m_key(key) {}
+        };
+
+        /** @brief Constructs an empty registry that accepts all algorithms but 'none'. */
+        KeyRegistry();
+        /** @brief Constructs an empty registry.
+         *  @param algorithms accepted algorithms.
+         */
+        explicit KeyRegistry(std::initializer_list<Algorithm> algorithms);
+        /** @brief Destructor. */
+        ~KeyRegistry();
+
+        KeyRegistry(const KeyRegistry&) = delete;
+        KeyRegistry& operator=(const KeyRegistry&) = delete;
+
+        /** @brief Checks whether the algorithm is accepted.
+         *  @param alg the algorithm.
+         */
+        bool allows(Algorithm alg) const noexcept { return (m_algorithms & (1u << static_cast<unsigned>(alg))) != 0; }
+
+        /** @brief Adds a key for its algorithm, replacing the key with the same id and algorithm.
+         *  @param kid key id, empty for tokens without 'kid';
+         *  @param key the key.
+         *  @throws Key::Error if the algorithm of the key is not accepted.
+         */
+        void add(const std::string& kid, Key key);
+
+        /** @brief Removes a key.
+         *  Verifications that already use the key finish with it.
+         *  @param kid key id;
+         *  @param alg key algorithm.
+         *  @return false if there is no such key.
+         */
+        bool remove(std::string_view kid, Algorithm alg);
+
+        /** @brief Returns the number of keys. */
+        size_t size() const noexcept;
+
+        /** @brief Returns the key for the id and the algorithm.
+         *  @param kid key id, empty for a key without an id;
+         *  @param alg key algorithm.
+         *  @return the key, an empty lease if there is no such key or the algorithm is not accepted.
+         */
+        Lease find(std::string_view kid, Algorithm alg) const noexcept;
+
+    private:
+        struct Impl;
+
+        uint32_t m_algorithms;
+        std::unique_ptr<Impl> m_impl;
+};
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/** @file keyset.h
+ *  @brief JSON Web Key sets.
+ */
+
+#include "jwt.h"
+
+#include <memory>
+#include <string_view>
+
+#include <cstddef>
+
+namespace JWTXX
+{
+
+/** @class KeySet
+ *  @brief Keys of a JWKS document (RFC 7517), indexed by their ids ('kid').
+ *  Supports RSA ('n', 'e'), EC ('crv', 'x', 'y') and symmetric ('k') keys. Keys of other types
+ *  and keys for encryption ('use' is 'enc') are skipped. A key is parsed when the set is constructed,
+ *  but its OpenSSL key is created only when it is used for the first time.
+ *  RSA and symmetric keys without 'alg' can be used with any hash size, EC keys with the one of their curve.
+ *  Keys may share an id if each algorithm is served by one of them, e.g. an RSA and an EC key.
+ *  A key set can be used by many threads at once.
+ */
+class KeySet
+{
+    public:
+        /** @brief Parses a JWKS document, e.g. {"keys": [{"kty": "RSA", "kid": "1", "n": "...", "e": "AQAB"}]}. A single JWK is accepted as well.
+         *  @param jwks the document.
+         *  @throws Key::Error if the document is malformed, a key is invalid or keys with the same id can be used with the same algorithm.
+         */
+        explicit KeySet(std::string_view jwks);
+        /** @brief Destructor. */
+        ~KeySet();
+
+        /** @brief Move constructor. */
+        KeySet(KeySet&&) noexcept;
+        /** @brief Move assignment. */
+        KeySet& operator=(KeySet&&) noexcept;
+
+        /** @brief Returns the number of keys. */
+        size_t size() const noexcept;
+
+        /** @brief Checks whether there is a key with the id.
+         *  @param kid key id, empty for a key without an id.
+         */
+        bool contains(std::string_view kid) const noexcept;
+
+        /** @brief Returns the key with the id for the algorithm, creating it on the first call.
+         *  @param kid key id, empty for a key without an id;
+         *  @param alg signature algorithm.
+         *  @return the key, nullptr if there is no such key or it can't be used with the algorithm.
+         *  @throws Key::Error if OpenSSL can't create the key.
+         */
+        const Key* find(std::string_view kid, Algorithm alg) const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+
+        friend void warmUp(const KeySet& keys);
+};
+
+/** @fn void warmUp(const KeySet& keys)
+ *  @brief Creates the keys of a key set for all algorithms they can be used with and warms them up, see warmUp(const Key&).
+ *  @param keys the key set.
+ *  @throws Key::Error
+ */
+void warmUp(const KeySet& keys);
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+/** @file keystore.h
+ *  @brief Keys reloaded when their files change.
+ */
+
+#include "jwt.h"
+#include "keyregistry.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+namespace JWTXX
+{
+
+/** @struct KeyFile
+ *  @brief A public key or certificate file of a KeyStore.
+ */
+struct KeyFile
+{
+    std::string kid;      /**< key id, empty for tokens without 'kid' */
+    Algorithm alg;        /**< key algorithm */
+    std::string fileName; /**< PEM or DER file */
+};
+
+/** @class KeyStore
+ *  @brief Verification keys that follow their files.
+ *  Keys are read from key files or from a JWKS file. When the files change, e.g. on a key rotation,
+ *  a background thread reads them again, loads and warms up the new keys and publishes them at once.
+ *  Lookups never lock and never wait for a reload; verifications that have started with the old keys
+ *  finish with them, the old keys are freed after that.
+ *  If the new files can't be read, the old keys stay in use and the error callback is called.
+ *  Files are watched with inotify on Linux, elsewhere call reload() yourself.
+ */
+class KeyStore
+{
+    public:
+        /** @typedef Lease
+         *  @brief A key found in the store, valid while the lease exists.
+         *  @note Don't call reload() in the thread that holds a lease, this waits for the lease to end.
+         */
+        using Lease = KeyRegistry::Lease;
+
+        /** @typedef ErrorCallback
+         *  @brief Receives the errors of background reloads.
+         *  Called from the background thread.
+         */
+        using ErrorCallback = std::function<void (const std::string&)>;
+
+        /** @brief Loads keys from key files and watches them.
+         *  @param files key files;
+         *  @param onError an optional error callback.
+         *  @throws Key::Error if a key can't be loaded or the files can't be watched.
+         */
+        explicit KeyStore(std::vector<KeyFile> files, ErrorCallback onError = {});
+
+        /** @brief Loads keys from a JWKS file and watches it.
+         *  @param jwksFile JWKS file, see KeySet;
+         *  @param onError an optional error callback.
+         *  @throws Key::Error if the keys can't be loaded or the file can't be watched.
+         */
+        explicit KeyStore(const std::string& jwksFile, ErrorCallback onError = {});
+
+        /** @brief Destructor, stops the background thread. */
+        ~KeyStore();
+
+        KeyStore(const KeyStore&) = delete;
+        KeyStore& operator=(const KeyStore&) = delete;
+
+        /** @brief Reads the files and publishes the new keys.
+         *  @throws Key::Error if the keys can't be loaded, the old keys stay in use.
+         */
+        void reload();
+
+        /** @brief Returns the number of times the keys were published, the initial keys included. */
+        size_t generation() const noexcept;
+
+        /** @brief Returns the key for the id and the algorithm.
+         *  @param kid key id, empty for a key without an id;
+         *  @param alg key algorithm.
+         *  @return the key, an empty lease if there is no such key.
+         */
+        Lease find(std::string_view kid, Algorithm alg) const noexcept;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+};
+
+}
@@ -2,6 +2,11 @@
 
 #include "utils.h"
 
+#include <mutex> // std::once_flag, std::call_once
+#include <string>
+#include <string_view>
+#include <utility> // std::move
+
 #include <openssl/evp.h>
 
 namespace JWTXX
@@ -9,71 +14,152 @@ namespace JWTXX
 namespace Keys
 {
 
+// Safe for concurrent use: each key is loaded exactly once, on the first operation that needs it,
+// together with a fully initialized context that each operation copies into a context from the per-thread pool.
 class Asymmetric
 {
     public:
         enum class Type {RSA, EC};
+        // Tells that the key data is the key itself, not a file name.
+        struct InMemory {};
 
-        Asymmetric(Type type, const EVP_MD* digest, const std::string& keyData, const Key::PasswordCallback& cb)
-            : m_type(type), m_digest(digest), m_data(keyData), m_cb(cb), m_ctx(EVP_MD_CTX_create())
+        Asymmetric(Type type, const char* digest, const std::string& keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context)
+            : m_type(type), m_digest(digest), m_data(keyData), m_cb(cb), m_context(context)
         {
-            if (!m_ctx)
-                throw Key::Error("Can't create message digest context. " + Utils::OPENSSLError());
+        }
+
+        // The key is parsed right away and the data is not kept. A private key verifies signatures as well.
+        Asymmetric(Type type, const char* digest, std::string_view keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context, InMemory)
+            : m_type(type), m_digest(digest), m_context(context), m_inMemory(true)
+        {
+            bool isPrivate = false;
+            auto key = Utils::parseKey(keyData, cb, typeName(), m_context, isPrivate);
+            if (isPrivate)
+            {
+                if (EVP_PKEY_up_ref(key.get()) != 1)
+                    throw Key::Error("Can't share private key. " + Utils::OPENSSLError());
+                Utils::EVPKeyPtr privKey(key.get());
+                std::call_once(m_privKeyFlag, [&]{ setPrivKey(std::move(privKey)); });
+            }
+            std::call_once(m_pubKeyFlag, [&]{ setPubKey(std::move(key)); });
         }
 
         Base64URL::Block sign(const void* data, size_t size)
         {
-            auto& key = getPrivKey();
-            if (EVP_DigestSignInit(m_ctx.get(), nullptr, m_digest, nullptr, key.get()) != 1)
+            getPrivKey();
+            const Utils::PooledMDCTX ctx;
+            if (EVP_MD_CTX_copy_ex(ctx.get(), m_signCtx.get()) != 1)
                 throw Key::Error("Can't init sign context. " + Utils::OPENSSLError());
-            if (EVP_DigestSignUpdate(m_ctx.get(), data, size) != 1)
+            if (EVP_DigestSignUpdate(ctx.get(), data, size) != 1)
                 throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
             size_t res = 0;
-            if (EVP_DigestSignFinal(m_ctx.get(), nullptr, &res) != 1)
+            if (EVP_DigestSignFinal(ctx.get(), nullptr, &res) != 1)
                 throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
             if (res == 0)
                 return {};
             Base64URL::Block block(res);
-            if (EVP_DigestSignFinal(m_ctx.get(), block.data<unsigned char*>(), &res) != 1)
+            if (EVP_DigestSignFinal(ctx.get(), block.data<unsigned char*>(), &res) != 1)
                 throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
             return block.shrink(res);
         }
 
-        bool verify(const void* data, size_t size, Base64URL::Block signature)
+        bool verify(const void* data, size_t size, const void* signature, size_t signatureSize)
         {
-            auto& key = getPubKey();
-            if (EVP_DigestVerifyInit(m_ctx.get(), nullptr, m_digest, nullptr, key.get()) != 1)
+            getPubKey();
+            const Utils::PooledMDCTX ctx;
+            if (EVP_MD_CTX_copy_ex(ctx.get(), m_verifyCtx.get()) != 1)
                 throw Key::Error("Can't init verification context. " + Utils::OPENSSLError());
-            if (EVP_DigestVerifyUpdate(m_ctx.get(), data, size) != 1)
+            if (EVP_DigestVerifyUpdate(ctx.get(), data, size) != 1)
                 throw Key::Error("Can't add data to verification. " + Utils::OPENSSLError());
-            auto rv = EVP_DigestVerifyFinal(m_ctx.get(), signature.data<unsigned char*>(), signature.size());
+            auto rv = EVP_DigestVerifyFinal(ctx.get(), static_cast<const unsigned char*>(signature), signatureSize);
             if (rv == 1) return true;
             if (rv == 0) return false;
             throw Key::Error("Can't verify signature. " + Utils::OPENSSLError());
         }
 
-        Utils::EVPKeyPtr& getPubKey()
+        // Public keys can't sign, so verification is warmed up without checking a signature.
+        void warmUpVerification()
+        {
+            getPubKey();
+            const char data[] = "warm-up";
+            const Utils::PooledMDCTX ctx;
+            if (EVP_MD_CTX_copy_ex(ctx.get(), m_verifyCtx.get()) != 1)
+                throw Key::Error("Can't init verification context. " + Utils::OPENSSLError());
+            if (EVP_DigestVerifyUpdate(ctx.get(), data, sizeof(data) - 1) != 1)
+                throw Key::Error("Can't add data to verification. " + Utils::OPENSSLError());
+        }
+
+        // A failed load is not remembered, the next call tries again and reports the error again.
+        const Utils::EVPKeyPtr& getPubKey()
         {
-            if (!m_pubKeyPtr)
-                m_pubKeyPtr = Utils::readPEMPublicKey(m_data, typeName());
+            std::call_once(m_pubKeyFlag, [this]{ setPubKey(Utils::readPublicKey(m_data, typeName(), m_context)); });
             return m_pubKeyPtr;
         }
 
-        Utils::EVPKeyPtr& getPrivKey()
+        const Utils::EVPKeyPtr& getPrivKey()
         {
-            if (!m_privKeyPtr)
-                m_privKeyPtr = Utils::readPEMPrivateKey(m_data, m_cb, typeName());
+            std::call_once(m_privKeyFlag, [this]{
+                if (m_inMemory)
+                    throw Key::Error("Can't sign with a public key.");
+                setPrivKey(Utils::readPrivateKey(m_data, m_cb, typeName(), m_context));
+            });
             return m_privKeyPtr;
         }
 
     private:
         Type m_type;
-        const EVP_MD* m_digest;
+        const char* m_digest;
         std::string m_data;
         Key::PasswordCallback m_cb;
+        Key::LibraryContext m_context;
         Utils::EVPKeyPtr m_pubKeyPtr;
         Utils::EVPKeyPtr m_privKeyPtr;
-        Utils::EVPMDCTXPtr m_ctx;
+        std::once_flag m_pubKeyFlag;
+        std::once_flag m_privKeyFlag;
+        // Initialized with the key and the digest, never used directly, only copied.
+        Utils::EVPMDCTXPtr m_signCtx;
+        Utils::EVPMDCTXPtr m_verifyCtx;
+        bool m_inMemory = false;
+
+        void setPubKey(Utils::EVPKeyPtr key)
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            m_verifyCtx = createContext(key, EVP_DigestVerifyInit_ex, "Can't init verification context. ");
+#else
+            m_verifyCtx = createContext(key, EVP_DigestVerifyInit, "Can't init verification context. ");
+#endif
+            m_pubKeyPtr = std::move(key);
+        }
+
+        void setPrivKey(Utils::EVPKeyPtr key)
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            m_signCtx = createContext(key, EVP_DigestSignInit_ex, "Can't init sign context. ");
+#else
+            m_signCtx = createContext(key, EVP_DigestSignInit, "Can't init sign context. ");
+#endif
+            m_privKeyPtr = std::move(key);
+        }
+
+        template <typename Init>
+        Utils::EVPMDCTXPtr createContext(const Utils::EVPKeyPtr& key, Init init, const char* error) const
+        {
+            Utils::EVPMDCTXPtr ctx(EVP_MD_CTX_create());
+            if (!ctx)
+                throw Key::Error("Can't create message digest context. " + Utils::OPENSSLError());
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            // Digest and signature implementations are fetched here, once per key.
+            if (init(ctx.get(), nullptr, m_digest, m_context.libCtx, Utils::propertyQuery(m_context), key.get(), nullptr) != 1)
+                throw Key::Error(error + Utils::OPENSSLError());
+#else
+            const auto* md = EVP_get_digestbyname(m_digest);
+            if (md == nullptr)
+                throw Key::Error("Unknown digest '" + std::string(m_digest) + "'.");
+            if (init(ctx.get(), nullptr, md, nullptr, key.get()) != 1)
+                throw Key::Error(error + Utils::OPENSSLError());
+#endif
+            return ctx;
+        }
 
         const char* typeName() const noexcept
         {
@@ -0,0 +1,398 @@
+#include "base64url.h"
+
+#include <array>
+
+#include <cstdint>
+#include <cstring> // memcpy
+
+#if defined(__x86_64__) || defined(__i386__)
+#define JWTXX_BASE64URL_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define JWTXX_BASE64URL_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Base64URL = JWTXX::Base64URL;
+
+namespace
+{
+
+constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+constexpr uint8_t invalid = 0xFF;
+
+constexpr std::array<uint8_t, 256> makeDecodeTable() noexcept
+{
+    std::array<uint8_t, 256> res{};
+    for (auto& v : res)
+        v = invalid;
+    for (size_t i = 0; i < 64; ++i)
+        res[static_cast<uint8_t>(alphabet[i])] = static_cast<uint8_t>(i);
+    return res;
+}
+
+constexpr auto decodeTable = makeDecodeTable();
+
+// Kernels process the bulk of the data and return the number of consumed input bytes.
+// Encoders consume whole 3-byte groups, decoders consume whole 4-char groups and stop
+// at the first block with an invalid character, leaving it to the scalar tail to report.
+using EncodeKernel = size_t (*)(const uint8_t* src, size_t size, char* dest);
+using DecodeKernel = size_t (*)(const char* src, size_t size, uint8_t* dest);
+
+size_t encodeScalar(const uint8_t* src, size_t size, char* dest) noexcept
+{
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3)
+    {
+        const uint32_t v = (uint32_t(src[i]) << 16) | (uint32_t(src[i + 1]) << 8) | src[i + 2];
+        *dest++ = alphabet[(v >> 18) & 0x3F];
+        *dest++ = alphabet[(v >> 12) & 0x3F];
+        *dest++ = alphabet[(v >> 6) & 0x3F];
+        *dest++ = alphabet[v & 0x3F];
+    }
+    return i;
+}
+
+size_t decodeScalar(const char* src, size_t size, uint8_t* dest) noexcept
+{
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        const auto a = decodeTable[static_cast<uint8_t>(src[i])];
+        const auto b = decodeTable[static_cast<uint8_t>(src[i + 1])];
+        const auto c = decodeTable[static_cast<uint8_t>(src[i + 2])];
+        const auto d = decodeTable[static_cast<uint8_t>(src[i + 3])];
+        if ((a | b | c | d) > 63)
+            break;
+        const uint32_t v = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | d;
+        *dest++ = static_cast<uint8_t>(v >> 16);
+        *dest++ = static_cast<uint8_t>(v >> 8);
+        *dest++ = static_cast<uint8_t>(v);
+    }
+    return i;
+}
+
+#ifdef JWTXX_BASE64URL_X86
+
+// See W. Mula, D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions".
+// The decoder uses plain range checks instead of nibble lookups to get the URL-safe alphabet.
+
+__attribute__((target("sse4.1")))
+__m128i encodeLookupSSE(__m128i indices) noexcept
+{
+    // 0..25 -> 13 ('A'), 26..51 -> 0 ('a' - 26), 52..61 -> 1..10 ('0' - 52), 62 -> 11 ('-'), 63 -> 12 ('_').
+    auto res = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const auto less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    res = _mm_or_si128(res, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const auto shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                     '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(shift, res), indices);
+}
+
+__attribute__((target("sse4.1")))
+size_t encodeSSE(const uint8_t* src, size_t size, char* dest) noexcept
+{
+    const auto shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    size_t i = 0;
+    // Loads 16 bytes, uses 12.
+    for (; i + 16 <= size; i += 12)
+    {
+        const auto in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), shuffle);
+        const auto t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        const auto t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), encodeLookupSSE(_mm_or_si128(t0, t1)));
+        dest += 16;
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+__m128i inRangeSSE(__m128i in, char lo, char hi) noexcept
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8(hi + 1)));
+}
+
+__attribute__((target("sse4.1")))
+bool decodeLookupSSE(__m128i in, __m128i& values) noexcept
+{
+    const auto upper = inRangeSSE(in, 'A', 'Z');
+    const auto lower = inRangeSSE(in, 'a', 'z');
+    const auto digit = inRangeSSE(in, '0', '9');
+    const auto dash = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+    const auto underscore = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+    const auto valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, dash), underscore));
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+        return false;
+    auto shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(shift, _mm_and_si128(dash, _mm_set1_epi8(62 - '-')));
+    shift = _mm_or_si128(shift, _mm_and_si128(underscore, _mm_set1_epi8(63 - '_')));
+    values = _mm_add_epi8(in, shift);
+    return true;
+}
+
+__attribute__((target("sse4.1")))
+__m128i decodePackSSE(__m128i values) noexcept
+{
+    const auto merged = _mm_madd_epi16(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("sse4.1")))
+void store12SSE(__m128i v, uint8_t* dest) noexcept
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest), v);
+    const auto tail = _mm_extract_epi32(v, 2);
+    memcpy(dest + 8, &tail, 4);
+}
+
+__attribute__((target("sse4.1")))
+size_t decodeSSE(const char* src, size_t size, uint8_t* dest) noexcept
+{
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i values;
+        if (!decodeLookupSSE(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), values))
+            break;
+        store12SSE(decodePackSSE(values), dest);
+        dest += 12;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t encodeAVX2(const uint8_t* src, size_t size, char* dest) noexcept
+{
+    const auto shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                         10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const auto shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0,
+                                        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+    size_t i = 0;
+    // Loads 12 bytes into each 128-bit lane, the last load reads 4 bytes past them.
+    for (; i + 28 <= size; i += 24)
+    {
+        const auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+        const auto in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuffle);
+        const auto t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+        const auto t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+        const auto indices = _mm256_or_si256(t0, t1);
+        auto res = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const auto less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        res = _mm256_or_si256(res, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        res = _mm256_add_epi8(_mm256_shuffle_epi8(shift, res), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), res);
+        dest += 32;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+__m256i inRangeAVX2(__m256i in, char lo, char hi) noexcept
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), in));
+}
+
+__attribute__((target("avx2")))
+size_t decodeAVX2(const char* src, size_t size, uint8_t* dest) noexcept
+{
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const auto in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        const auto upper = inRangeAVX2(in, 'A', 'Z');
+        const auto lower = inRangeAVX2(in, 'a', 'z');
+        const auto digit = inRangeAVX2(in, '0', '9');
+        const auto dash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('-'));
+        const auto underscore = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_'));
+        const auto valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, dash), underscore));
+        if (_mm256_movemask_epi8(valid) != -1)
+            break;
+        auto shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(dash, _mm256_set1_epi8(62 - '-')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(underscore, _mm256_set1_epi8(63 - '_')));
+        const auto values = _mm256_add_epi8(in, shift);
+        const auto merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+        const auto packed = _mm256_shuffle_epi8(merged, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                                         2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        store12SSE(_mm256_castsi256_si128(packed), dest);
+        store12SSE(_mm256_extracti128_si256(packed, 1), dest + 12);
+        dest += 24;
+    }
+    return i;
+}
+
+#endif
+
+#ifdef JWTXX_BASE64URL_NEON
+
+size_t encodeNEON(const uint8_t* src, size_t size, char* dest) noexcept
+{
+    const auto* abc = reinterpret_cast<const uint8_t*>(alphabet);
+    const uint8x16x4_t table = {{vld1q_u8(abc), vld1q_u8(abc + 16), vld1q_u8(abc + 32), vld1q_u8(abc + 48)}};
+    const auto mask = vdupq_n_u8(0x3F);
+    size_t i = 0;
+    for (; i + 48 <= size; i += 48)
+    {
+        const auto in = vld3q_u8(src + i);
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+        for (auto& v : out.val)
+            v = vqtbl4q_u8(table, v);
+        vst4q_u8(reinterpret_cast<uint8_t*>(dest), out);
+        dest += 64;
+    }
+    return i;
+}
+
+size_t decodeNEON(const char* src, size_t size, uint8_t* dest) noexcept
+{
+    const auto* t = decodeTable.data();
+    const uint8x16x4_t lo = {{vld1q_u8(t), vld1q_u8(t + 16), vld1q_u8(t + 32), vld1q_u8(t + 48)}};
+    const uint8x16x4_t hi = {{vld1q_u8(t + 64), vld1q_u8(t + 80), vld1q_u8(t + 96), vld1q_u8(t + 112)}};
+    const auto offset = vdupq_n_u8(64);
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64)
+    {
+        auto in = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        auto bad = vdupq_n_u8(0);
+        for (auto& v : in.val)
+        {
+            // Chars 0..63 come from the first table, 64..127 from the second, 128..255 are invalid.
+            const auto high = vcgeq_u8(v, vdupq_n_u8(128));
+            v = vqtbx4q_u8(vqtbl4q_u8(lo, v), hi, vsubq_u8(v, offset));
+            bad = vorrq_u8(bad, vorrq_u8(high, v));
+        }
+        if (vmaxvq_u8(bad) > 63)
+            break;
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2), vshrq_n_u8(in.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+        vst3q_u8(dest, out);
+        dest += 48;
+    }
+    return i;
+}
+
+#endif
+
+struct Kernels
+{
+    EncodeKernel encode;
+    DecodeKernel decode;
+};
+
+Kernels selectKernels() noexcept
+{
+#if defined(JWTXX_BASE64URL_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {encodeAVX2, decodeAVX2};
+    if (__builtin_cpu_supports("sse4.1"))
+        return {encodeSSE, decodeSSE};
+#elif defined(JWTXX_BASE64URL_NEON)
+    return {encodeNEON, decodeNEON};
+#endif
+    return {encodeScalar, decodeScalar};
+}
+
+const Kernels& kernels() noexcept
+{
+    static const Kernels res = selectKernels();
+    return res;
+}
+
+}
+
+namespace
+{
+
+size_t stripPadding(std::string_view data) noexcept
+{
+    // Tolerate padding, JWT implementations are not required to strip it.
+    auto size = data.size();
+    if (size % 4 == 0 && size > 0 && data[size - 1] == '=')
+        size -= data[size - 2] == '=' ? 2 : 1;
+    return size;
+}
+
+}
+
+size_t Base64URL::decodedSize(std::string_view data) noexcept
+{
+    const auto size = stripPadding(data);
+    return size / 4 * 3 + (size % 4 == 0 ? 0 : size % 4 - 1);
+}
+
+void Base64URL::encode(const void* data, size_t size, char* dest) noexcept
+{
+    const auto* src = static_cast<const uint8_t*>(data);
+    auto i = kernels().encode(src, size, dest);
+    i += encodeScalar(src + i, size - i, dest + i / 3 * 4);
+    dest += i / 3 * 4;
+    const auto rest = size - i;
+    if (rest == 0)
+        return;
+    const uint32_t v = (uint32_t(src[i]) << 16) | (rest == 2 ? uint32_t(src[i + 1]) << 8 : 0);
+    dest[0] = alphabet[(v >> 18) & 0x3F];
+    dest[1] = alphabet[(v >> 12) & 0x3F];
+    if (rest == 2)
+        dest[2] = alphabet[(v >> 6) & 0x3F];
+}
+
+void Base64URL::encodeAppend(std::string& dest, const void* data, size_t size)
+{
+    const auto pos = dest.size();
+    dest.resize(pos + encodedSize(size));
+    encode(data, size, dest.data() + pos);
+}
+
+bool Base64URL::decodeInto(std::string_view data, MutableSpan dest, size_t& size) noexcept
+{
+    const auto length = stripPadding(data);
+    if (length % 4 == 1)
+        return false;
+    const auto res = decodedSize(data);
+    if (res > dest.size())
+        return false;
+
+    const auto* src = data.data();
+    auto* out = static_cast<uint8_t*>(dest.data());
+    auto i = kernels().decode(src, length, out);
+    i += decodeScalar(src + i, length - i, out + i / 4 * 3);
+    out += i / 4 * 3;
+    const auto rest = length - i;
+    if (rest >= 4)
+        return false; // The scalar decoder stopped at an invalid group.
+    if (rest > 0)
+    {
+        uint32_t v = 0;
+        uint8_t check = 0;
+        for (size_t j = 0; j < rest; ++j)
+        {
+            const auto c = decodeTable[static_cast<uint8_t>(src[i + j])];
+            check |= c;
+            v |= uint32_t(c) << (18 - 6 * j);
+        }
+        if (check > 63)
+            return false;
+        // Unused low bits must be zero, so every byte string has exactly one encoding.
+        if ((v & (rest == 2 ? 0xFFFFU : 0xFFU)) != 0)
+            return false;
+        out[0] = static_cast<uint8_t>(v >> 16);
+        if (rest == 3)
+            out[1] = static_cast<uint8_t>(v >> 8);
+    }
+    size = res;
+    return true;
+}
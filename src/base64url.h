@@ -3,12 +3,13 @@
 #include "jwtxx/error.h"
 
 #include <string>
+#include <string_view>
+#include <array>
 
-#include <openssl/evp.h>
 #include <openssl/crypto.h>
-#include <openssl/bio.h>
 
 #include <cstring>
+#include <cstdint>
 
 namespace JWTXX
 {
@@ -58,110 +59,65 @@ class Block
         Block(void* buffer, size_t size) noexcept : m_buffer(buffer), m_size(size) {}
 };
 
-inline
-std::string URLEncode(const std::string& data) noexcept
+class MutableSpan
 {
-    if (data.empty())
-        return {};
+    public:
+        MutableSpan(void* data, size_t size) noexcept : m_data(data), m_size(size) {}
+        template <typename T, size_t N>
+        MutableSpan(std::array<T, N>& array) noexcept : m_data(array.data()), m_size(sizeof(T) * N) {}
 
-    std::string res;
-    res.reserve(data.size());
-    for (const auto& ch : data)
-    {
-        if (ch == '=')
-            continue;
-        else if (ch == '/')
-            res += '_';
-        else if (ch == '+')
-            res += '-';
-        else
-            res += ch;
-    }
-    return res;
+        void* data() const noexcept { return m_data; }
+        size_t size() const noexcept { return m_size; }
+
+    private:
+        void* m_data;
+        size_t m_size;
+};
+
+// Exact length of the unpadded base64url representation of 'size' bytes.
+constexpr size_t encodedSize(size_t size) noexcept
+{
+    return size / 3 * 4 + (size % 3 == 0 ? 0 : size % 3 + 1);
 }
 
+// Exact decoded size of well-formed base64url data, trailing padding is ignored.
+size_t decodedSize(std::string_view data) noexcept;
+
+// Writes encodedSize(size) characters to 'dest'.
+void encode(const void* data, size_t size, char* dest) noexcept;
+// Appends the encoded data to 'dest' with a single resize.
+void encodeAppend(std::string& dest, const void* data, size_t size);
+// Decodes into a caller-provided buffer. Returns false on malformed or non-canonical input or if 'dest' is too small.
+bool decodeInto(std::string_view data, MutableSpan dest, size_t& size) noexcept;
+
 inline
-std::string URLDecode(const std::string& data) noexcept
+std::string encode(const void* data, size_t size)
 {
-    if (data.empty())
-        return {};
-
     std::string res;
-    res.reserve(data.size());
-    for (const auto& ch : data)
-    {
-        if (ch == '_')
-            res += '/';
-        else if (ch == '-')
-            res += '+';
-        else
-            res += ch;
-    }
-
-    if (res.size() % 4 == 2)
-        return res + "==";
-    else if (res.size() % 4 == 3)
-        return res + "=";
-
+    encodeAppend(res, data, size);
     return res;
 }
 
 inline
 std::string encode(const Block& block)
 {
-    BIO* bio = BIO_push(BIO_new(BIO_f_base64()), BIO_new(BIO_s_mem()));
-    if (bio == nullptr)
-        throw Error("Base64URL: cannot allocate base64 encoder.");
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    const auto rv = BIO_write(bio, block.data(), block.size());
-    if (rv < 0)
-    {
-        BIO_free_all(bio);
-        throw Error("Base64URL: cannot encode input data.");
-    }
-
-    std::string res;
-
-    if (BIO_flush(bio) == 1)
-    {
-        char* buf = nullptr;
-        size_t size = BIO_get_mem_data(bio, &buf);
-        if (size != 0 && buf != nullptr)
-            res.assign(buf, size);
-    }
-
-    BIO_free_all(bio);
-
-    return URLEncode(res);
+    return encode(block.data(), block.size());
 }
 
 inline
-std::string encode(const std::string& data)
+std::string encode(std::string_view data)
 {
-    Block block(data.size());
-    memcpy(block.data(), data.c_str(), data.size());
-    return encode(block);
+    return encode(data.data(), data.size());
 }
 
 inline
-Block decode(std::string data)
+Block decode(std::string_view data)
 {
-    data = URLDecode(data);
-
-    BIO* bio = BIO_push(BIO_new(BIO_f_base64()), BIO_new_mem_buf(const_cast<char*>(data.c_str()), data.size()));
-    if (bio == nullptr)
-        throw Error("Base64URL: cannot allocate base64 decoder.");
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    Block block(data.size());
-    const auto rv = BIO_read(bio, block.data(), block.size());
-    if (rv < 0)
-    {
-        BIO_free_all(bio);
+    Block block(decodedSize(data));
+    size_t size = 0;
+    if (!decodeInto(data, MutableSpan(block.data(), block.size()), size))
         throw Error("Base64URL: cannot decode input data.");
-    }
-    BIO_free_all(bio);
-
-    return block.shrink(rv);
+    return block;
 }
 
 }
@@ -0,0 +1,275 @@
+#include "jwtxx/batch.h"
+
+#include "json.h"
+#include "base64url.h"
+
+#include <algorithm> // std::min, std::max, std::sort
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility> // std::exchange
+#include <vector>
+
+using JWTXX::ThreadPoolExecutor;
+using JWTXX::Executor;
+using JWTXX::ValidationResult;
+using JWTXX::Verifier;
+using JWTXX::TokenBatch;
+
+namespace Base64URL = JWTXX::Base64URL;
+
+namespace
+{
+
+// Tokens of a range [begin, end) signed by one task, concatenated.
+struct Chunk
+{
+    size_t begin;
+    std::string data;
+    std::vector<size_t> sizes;
+};
+
+// Items of a batch assigned to a thread. Aligned to keep threads off each other's cache lines.
+struct alignas(64) Range
+{
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+};
+
+}
+
+struct ThreadPoolExecutor::Impl
+{
+    explicit Impl(size_t threads)
+        : ranges(threads)
+    {
+        workers.reserve(threads - 1);
+        for (size_t i = 0; i + 1 < threads; ++i)
+            workers.emplace_back([this, i] { loop(i); });
+    }
+
+    ~Impl()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    Impl(const Impl&) = delete;
+    Impl& operator=(const Impl&) = delete;
+
+    // The last range belongs to the thread that runs the batch.
+    std::vector<Range> ranges;
+    std::vector<std::thread> workers;
+
+    std::mutex runMutex; // One batch at a time.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    size_t generation = 0;
+    size_t active = 0;
+    bool stop = false;
+    const Task* task = nullptr;
+    size_t grain = 1;
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    static thread_local const Impl* current;
+
+    void run(size_t count, const Task& batchTask)
+    {
+        const std::lock_guard<std::mutex> runLock(runMutex);
+
+        const auto share = count / ranges.size();
+        const auto rest = count % ranges.size();
+        size_t begin = 0;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            const auto end = begin + share + (i < rest ? 1 : 0);
+            ranges[i].next = begin;
+            ranges[i].end = end;
+            begin = end;
+        }
+        // Small enough to balance the load, large enough to keep the atomics cold.
+        grain = std::max<size_t>(1, std::min<size_t>(64, count / (ranges.size() * 8)));
+
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            task = &batchTask;
+            active = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        current = this;
+        work(ranges.size() - 1);
+        current = nullptr;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active == 0; });
+        task = nullptr;
+        if (error)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+    void loop(size_t self)
+    {
+        current = this;
+        size_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop)
+                    return;
+                seen = generation;
+            }
+            work(self);
+            {
+                const std::lock_guard<std::mutex> lock(mutex);
+                if (--active == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    // Takes items from its own range first, then steals from the others.
+    void work(size_t self) noexcept
+    {
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            auto& range = ranges[(self + i) % ranges.size()];
+            for (;;)
+            {
+                const auto begin = range.next.fetch_add(grain);
+                if (begin >= range.end)
+                    break;
+                try
+                {
+                    (*task)(begin, std::min(begin + grain, range.end));
+                }
+                catch (...)
+                {
+                    const std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        }
+    }
+};
+
+thread_local const ThreadPoolExecutor::Impl* ThreadPoolExecutor::Impl::current = nullptr;
+
+ThreadPoolExecutor::ThreadPoolExecutor(size_t threads)
+    : m_impl(new Impl(threads != 0 ? threads : std::max<size_t>(1, std::thread::hardware_concurrency())))
+{
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() = default;
+
+size_t ThreadPoolExecutor::threads() const noexcept
+{
+    return m_impl->ranges.size();
+}
+
+void ThreadPoolExecutor::run(size_t count, const Task& task)
+{
+    if (count == 0)
+        return;
+    // A nested batch would wait for the threads that run the outer one.
+    if (Impl::current == m_impl.get() || m_impl->workers.empty())
+    {
+        task(0, count);
+        return;
+    }
+    m_impl->run(count, task);
+}
+
+Executor& JWTXX::defaultExecutor()
+{
+    static ThreadPoolExecutor executor;
+    return executor;
+}
+
+std::vector<ValidationResult> JWTXX::verifyBatch(Span<const std::string_view> tokens, const Key& key, const ValidatorSet& validators, Executor& executor)
+{
+    // Loads the key before the threads start.
+    const Verifier verifier(key, validators);
+    std::vector<ValidationResult> res(tokens.size(), ValidationResult::ok());
+    executor.run(tokens.size(), [&](size_t begin, size_t end)
+                                {
+                                    for (auto i = begin; i < end; ++i)
+                                        res[i] = verifier.verify(tokens[i]);
+                                });
+    return res;
+}
+
+std::vector<ValidationResult> JWTXX::verifyBatch(Span<const std::string_view> tokens, const Key& key, const ValidatorSet& validators)
+{
+    return verifyBatch(tokens, key, validators, defaultExecutor());
+}
+
+TokenBatch JWTXX::signBatch(Span<const Value::Object> claims, const Key& key, Executor& executor, const Value::Object& header)
+{
+    // Serialized once for all tokens, with the same 'alg' and 'typ' as in JWT::token.
+    const auto headerJSON = toJSON(JWT(key.alg(), {}, header).header());
+    std::string prefix;
+    Base64URL::encodeAppend(prefix, headerJSON.data(), headerJSON.size());
+    prefix += '.';
+
+    std::mutex mutex;
+    std::vector<Chunk> chunks;
+    executor.run(claims.size(), [&](size_t begin, size_t end)
+                                {
+                                    Chunk chunk{begin, {}, {}};
+                                    chunk.sizes.reserve(end - begin);
+                                    std::string data;
+                                    for (auto i = begin; i < end; ++i)
+                                    {
+                                        const auto claimsJSON = toJSON(claims[i]);
+                                        data = prefix;
+                                        Base64URL::encodeAppend(data, claimsJSON.data(), claimsJSON.size());
+                                        const auto signature = key.sign(data.data(), data.size());
+                                        const auto before = chunk.data.size();
+                                        chunk.data += data;
+                                        if (!signature.empty())
+                                        {
+                                            chunk.data += '.';
+                                            chunk.data += signature;
+                                        }
+                                        chunk.sizes.push_back(chunk.data.size() - before);
+                                    }
+                                    const std::lock_guard<std::mutex> lock(mutex);
+                                    chunks.push_back(std::move(chunk));
+                                });
+
+    std::sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.begin < b.begin; });
+    TokenBatch res;
+    size_t total = 0;
+    for (const auto& chunk : chunks)
+        total += chunk.data.size();
+    res.m_data.reserve(total);
+    res.m_offsets.reserve(claims.size() + 1);
+    for (const auto& chunk : chunks)
+    {
+        res.m_data += chunk.data;
+        for (const auto size : chunk.sizes)
+            res.m_offsets.push_back(res.m_offsets.back() + size);
+    }
+    return res;
+}
+
+TokenBatch JWTXX::signBatch(Span<const Value::Object> claims, const Key& key)
+{
+    return signBatch(claims, key, defaultExecutor());
+}
@@ -0,0 +1,293 @@
+#include "jwtxx/cache.h"
+
+#include "keyimpl.h"
+
+#include <algorithm> // std::max
+#include <atomic>
+#include <iterator> // std::prev
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility> // std::move
+#include <vector>
+
+#include <cstdint>
+#include <cstring> // std::memcpy
+#include <ctime>
+
+#include <openssl/rand.h>
+
+using JWTXX::VerifiedTokenCache;
+using JWTXX::ValidationResult;
+using JWTXX::Verifier;
+using JWTXX::JWT;
+
+namespace
+{
+
+uint64_t rotl(uint64_t v, int bits) noexcept
+{
+    return (v << bits) | (v >> (64 - bits));
+}
+
+void sipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) noexcept
+{
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+}
+
+// SipHash-1-3, keyed with a per-cache random secret, so clients can't craft colliding tokens.
+uint64_t sipHash(uint64_t k0, uint64_t k1, std::string_view data) noexcept
+{
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+    const auto* p = data.data();
+    const auto* end = p + (data.size() & ~size_t(7));
+    for (; p != end; p += 8)
+    {
+        uint64_t m = 0;
+        std::memcpy(&m, p, 8); // Native byte order, hashes never leave the process.
+        v3 ^= m;
+        sipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t last = static_cast<uint64_t>(data.size()) << 56;
+    for (size_t i = 0; i < (data.size() & 7); ++i)
+        last |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    v3 ^= last;
+    sipRound(v0, v1, v2, v3);
+    v0 ^= last;
+    v2 ^= 0xff;
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+struct Entry
+{
+    uint64_t hash;
+    uint64_t keyId;
+    std::string token;
+    std::time_t exp;
+    size_t cost;
+    std::shared_ptr<const JWT> jwt;
+};
+
+// Parsed claims and header are not measured exactly, a rough estimate is enough for a budget.
+size_t estimateCost(const std::string& token, const JWT& jwt) noexcept
+{
+    constexpr size_t nodeCost = 96;
+    return sizeof(Entry) + sizeof(JWT) + nodeCost + 2 * token.size() + nodeCost * (jwt.header().size() + jwt.claims().size());
+}
+
+struct alignas(64) Shard
+{
+    std::mutex mutex;
+    // The most recently used entry first.
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    size_t memory = 0;
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> misses{0};
+
+    void erase(std::list<Entry>::iterator it) noexcept
+    {
+        memory -= it->cost;
+        index.erase(it->hash);
+        entries.erase(it);
+    }
+};
+
+}
+
+struct VerifiedTokenCache::Impl
+{
+    Impl(size_t memoryBudget, size_t shardCount)
+        : shards(shardCount),
+          shardBudget(memoryBudget / shardCount)
+    {
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(secret), sizeof(secret)) != 1)
+            throw std::runtime_error("Can't generate cache secret.");
+    }
+
+    std::vector<Shard> shards;
+    size_t shardBudget;
+    uint64_t secret[2] = {0, 0};
+
+    uint64_t hash(uint64_t keyId, std::string_view token) const noexcept
+    {
+        return sipHash(secret[0] ^ keyId, secret[1], token);
+    }
+
+    Shard& shard(uint64_t hash) noexcept
+    {
+        return shards[(hash >> 32) % shards.size()];
+    }
+
+    std::shared_ptr<const JWT> find(uint64_t h, uint64_t keyId, std::string_view token)
+    {
+        auto& s = shard(h);
+        const auto now = JWTXX::coarseTime();
+        const std::lock_guard<std::mutex> lock(s.mutex);
+        const auto it = s.index.find(h);
+        if (it == s.index.end())
+            return {};
+        const auto entry = it->second;
+        if (entry->keyId != keyId || entry->token != token)
+            return {};
+        if (entry->exp <= now)
+        {
+            s.erase(entry);
+            return {};
+        }
+        s.entries.splice(s.entries.begin(), s.entries, entry);
+        return entry->jwt;
+    }
+
+    void insert(uint64_t h, uint64_t keyId, std::string_view token, std::shared_ptr<const JWT> jwt)
+    {
+        const auto exp = jwt->claims().find("exp");
+        if (exp == jwt->claims().end() || !exp->second.isInteger())
+            return;
+        Entry entry{h, keyId, std::string(token), static_cast<std::time_t>(exp->second.getInteger()), 0, std::move(jwt)};
+        entry.cost = estimateCost(entry.token, *entry.jwt);
+        if (entry.cost > shardBudget)
+            return;
+
+        auto& s = shard(h);
+        const std::lock_guard<std::mutex> lock(s.mutex);
+        // A colliding or concurrently inserted entry is replaced.
+        const auto it = s.index.find(h);
+        if (it != s.index.end())
+            s.erase(it->second);
+        while (!s.entries.empty() && s.memory + entry.cost > shardBudget)
+            s.erase(std::prev(s.entries.end()));
+        s.memory += entry.cost;
+        s.entries.push_front(std::move(entry));
+        s.index.emplace(h, s.entries.begin());
+    }
+
+    // Looks the token up, counting hits and misses.
+    std::shared_ptr<const JWT> lookup(uint64_t h, uint64_t keyId, std::string_view token)
+    {
+        auto jwt = find(h, keyId, token);
+        if (jwt)
+            ++shard(h).hits;
+        else
+            ++shard(h).misses;
+        return jwt;
+    }
+
+    // Runs the validators on a cached token, like Verifier does after checking the signature.
+    static ValidationResult validate(const JWT& jwt, const Verifier& verifier) noexcept
+    {
+        try
+        {
+            return verifier.m_validators.validate(jwt.claims());
+        }
+        catch (const std::runtime_error& error)
+        {
+            return ValidationResult::failure(error.what());
+        }
+    }
+};
+
+VerifiedTokenCache::VerifiedTokenCache(size_t memoryBudget, size_t shards)
+    : m_impl(new Impl(memoryBudget, shards != 0 ? shards : std::max<size_t>(16, 2 * std::thread::hardware_concurrency())))
+{
+}
+
+VerifiedTokenCache::~VerifiedTokenCache() = default;
+
+ValidationResult VerifiedTokenCache::verify(std::string_view token, const Verifier& verifier) noexcept
+{
+    // Rejected anyway, not worth hashing.
+    if (token.size() > verifier.m_limits.maxTokenSize)
+        return verifier.verify(token);
+    const auto keyId = verifier.key().m_impl->id;
+    const auto h = m_impl->hash(keyId, token);
+    if (const auto jwt = m_impl->lookup(h, keyId, token))
+        return Impl::validate(*jwt, verifier);
+    // Rejected tokens don't throw here, they are the common case under attack.
+    auto res = verifier.tryDecode(token);
+    if (!res)
+        return std::move(res.m_result);
+    m_impl->insert(h, keyId, token, std::make_shared<const JWT>(std::move(res).jwt()));
+    return ValidationResult::ok();
+}
+
+JWT VerifiedTokenCache::decode(std::string_view token, const Verifier& verifier)
+{
+    if (token.size() > verifier.m_limits.maxTokenSize)
+        return verifier.decode(token);
+    const auto keyId = verifier.key().m_impl->id;
+    const auto h = m_impl->hash(keyId, token);
+    if (const auto jwt = m_impl->lookup(h, keyId, token))
+    {
+        const auto res = Impl::validate(*jwt, verifier);
+        if (!res)
+            throw JWT::ValidationError(res.message());
+        return *jwt;
+    }
+    const auto jwt = std::make_shared<const JWT>(verifier.decode(token));
+    m_impl->insert(h, keyId, token, jwt);
+    return *jwt;
+}
+
+void VerifiedTokenCache::clear() noexcept
+{
+    for (auto& s : m_impl->shards)
+    {
+        const std::lock_guard<std::mutex> lock(s.mutex);
+        s.index.clear();
+        s.entries.clear();
+        s.memory = 0;
+    }
+}
+
+size_t VerifiedTokenCache::hits() const noexcept
+{
+    size_t res = 0;
+    for (const auto& s : m_impl->shards)
+        res += s.hits;
+    return res;
+}
+
+size_t VerifiedTokenCache::misses() const noexcept
+{
+    size_t res = 0;
+    for (const auto& s : m_impl->shards)
+        res += s.misses;
+    return res;
+}
+
+size_t VerifiedTokenCache::size() const noexcept
+{
+    size_t res = 0;
+    for (auto& s : m_impl->shards)
+    {
+        const std::lock_guard<std::mutex> lock(s.mutex);
+        res += s.entries.size();
+    }
+    return res;
+}
+
+size_t VerifiedTokenCache::memoryUsage() const noexcept
+{
+    size_t res = 0;
+    for (auto& s : m_impl->shards)
+    {
+        const std::lock_guard<std::mutex> lock(s.mutex);
+        res += s.memory;
+    }
+    return res;
+}
@@ -3,32 +3,11 @@
 #include "asymmetric.h"
 #include "utils.h"
 
-#include <openssl/ecdsa.h>
-#include <openssl/bn.h>
-#include <openssl/crypto.h>
+#include <array>
+#include <mutex> // std::once_flag, std::call_once
+#include <utility> // std::pair
 
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-inline
-void ECDSA_SIG_get0(const ECDSA_SIG *sig, const BIGNUM **pr, const BIGNUM **ps)
-{
-   if (pr != NULL)
-       *pr = sig->r;
-   if (ps != NULL)
-       *ps = sig->s;
-}
-
-inline
-int ECDSA_SIG_set0(ECDSA_SIG *sig, BIGNUM *r, BIGNUM *s)
-{
-   if (r == NULL || s == NULL)
-       return 0;
-   BN_clear_free(sig->r);
-   BN_clear_free(sig->s);
-   sig->r = r;
-   sig->s = s;
-   return 1;
-}
-#endif
+#include <cstring> // memcpy
 
 namespace JWTXX
 {
@@ -38,81 +17,157 @@ namespace Keys
 class EC : public Key::Impl
 {
     public:
-        EC(const EVP_MD* digest, const std::string& keyData, const Key::PasswordCallback& cb) noexcept
-            : m_key(Asymmetric::Type::EC, digest, keyData, cb), m_primeSize(0)
+        EC(const char* digest, const std::string& keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context) noexcept
+            : m_key(Asymmetric::Type::EC, digest, keyData, cb, context), m_primeSize(0)
+        {
+        }
+        EC(const char* digest, std::string_view keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context, Asymmetric::InMemory tag)
+            : m_key(Asymmetric::Type::EC, digest, keyData, cb, context, tag), m_primeSize(0)
         {
+            initPrimeSize(m_key.getPubKey());
         }
 
         std::string sign(const void* data, size_t size) override
         {
-            if (m_primeSize == 0)
-                m_primeSize = primeSize(m_key.getPrivKey());
-            return Base64URL::encode(unpack(m_key.sign(data, size)));
+            initPrimeSize(m_key.getPrivKey());
+            auto der = m_key.sign(data, size);
+            std::array<unsigned char, maxSignatureSize> raw{};
+            unpack(der.data<const unsigned char*>(), der.size(), raw.data());
+            return Base64URL::encode(raw.data(), m_primeSize * 2);
         }
 
-        bool verify(const void* data, size_t size, const std::string& signature) override
+        bool verify(const void* data, size_t size, std::string_view signature) override
+        {
+            initPrimeSize(m_key.getPubKey());
+            // A signature of a wrong size is just an invalid signature, like in HMAC.
+            if (Base64URL::decodedSize(signature) != m_primeSize * 2)
+                return false;
+            std::array<unsigned char, maxSignatureSize> raw;
+            size_t rawSize = 0;
+            if (!Base64URL::decodeInto(signature, raw, rawSize))
+                return false;
+            std::array<unsigned char, maxDERSize> der;
+            const auto derSize = pack(raw.data(), der.data());
+            return m_key.verify(data, size, der.data(), derSize);
+        }
+        void prepareVerification() override
+        {
+            initPrimeSize(m_key.getPubKey());
+        }
+        void prepareSigning() override
+        {
+            initPrimeSize(m_key.getPrivKey());
+        }
+        void warmUp(Key::Usage usage) override
         {
-            if (m_primeSize == 0)
-                m_primeSize = primeSize(m_key.getPubKey());
-            return m_key.verify(data, size, pack(Base64URL::decode(signature)));
+            if (usage == Key::Usage::Signing)
+                Impl::warmUp(usage);
+            else
+            {
+                prepareVerification();
+                m_key.warmUpVerification();
+            }
         }
     private:
+        // P-521 is the largest supported curve.
+        static constexpr size_t maxPrimeSize = 66;
+        // r || s
+        static constexpr size_t maxSignatureSize = 2 * maxPrimeSize;
+        // SEQUENCE {INTEGER r, INTEGER s}, integers may need a leading zero byte to stay positive.
+        static constexpr size_t maxDERSize = 3 + 2 * (2 + maxPrimeSize + 1);
+
         Asymmetric m_key;
         size_t m_primeSize;
+        std::once_flag m_primeSizeFlag;
 
-        struct SigDeleter
+        // Both keys of a pair have the same curve, whichever is loaded first defines the size.
+        void initPrimeSize(const Utils::EVPKeyPtr& key)
         {
-            void operator()(ECDSA_SIG* ptr) { ECDSA_SIG_free(ptr); }
-        };
-        using SigPtr = std::unique_ptr<ECDSA_SIG, SigDeleter>;
-        Base64URL::Block unpack(Base64URL::Block src)
+            std::call_once(m_primeSizeFlag, [&]{
+                const auto res = primeSize(key);
+                if (res == 0 || res > maxPrimeSize)
+                    throw Key::Error("Unsupported EC key, field prime size is " + std::to_string(res) + " bytes.");
+                m_primeSize = res;
+            });
+        }
+
+        // ECDSA signatures are small and the DER structure is fixed, so it is converted by hand,
+        // without BIGNUMs, ECDSA_SIG and the allocations of i2d/d2i.
+        void unpack(const unsigned char* src, size_t size, unsigned char* dest) const
         {
-            // Unpack data
-            auto srcSig = src.data<const unsigned char*>();
-            SigPtr sig(d2i_ECDSA_SIG(nullptr, &srcSig, src.size()));
-            if (sig == nullptr)
-                throw Key::Error("Can't unpack DER-encoded signature. " + Utils::OPENSSLError());
+            size_t pos = 0;
+            if (size < 2 || src[pos++] != 0x30)
+                throw Key::Error("Can't unpack DER-encoded signature.");
+            size_t length = src[pos++];
+            if (length == 0x81 && pos < size)
+                length = src[pos++];
+            else if (length > 0x7F)
+                throw Key::Error("Can't unpack DER-encoded signature.");
+            if (length != size - pos)
+                throw Key::Error("Can't unpack DER-encoded signature.");
 
-            const BIGNUM* r = nullptr;
-            const BIGNUM* s = nullptr;
-            ECDSA_SIG_get0(sig.get(), &r, &s);
-            if (r == nullptr || s == nullptr)
+            const auto r = unpackInteger(src, size, pos);
+            const auto s = unpackInteger(src, size, pos);
+            if (pos != size)
                 throw Key::Error("Can't unpack DER-encoded signature.");
 
             // Check sizes
-            auto rSize = static_cast<size_t>(BN_num_bytes(r));
-            auto sSize = static_cast<size_t>(BN_num_bytes(s));
-            if (rSize > m_primeSize || sSize > m_primeSize)
-                throw Key::Error("Signature param sizes are inconsistent with the field prime size (p: " + std::to_string(m_primeSize) + ", r: " + std::to_string(rSize) + ", s: " + std::to_string(sSize) + ").");
+            if (r.second > m_primeSize || s.second > m_primeSize)
+                throw Key::Error("Signature param sizes are inconsistent with the field prime size (p: " + std::to_string(m_primeSize) + ", r: " + std::to_string(r.second) + ", s: " + std::to_string(s.second) + ").");
 
             // Put them raw, leading zeros
-            auto dest = Base64URL::Block::zero(m_primeSize * 2);
-            BN_bn2bin(r, dest.dataAt<unsigned char*>(m_primeSize - rSize));
-            BN_bn2bin(s, dest.dataAt<unsigned char*>(m_primeSize * 2 - sSize));
-            return dest;
+            memcpy(dest + m_primeSize - r.second, r.first, r.second);
+            memcpy(dest + m_primeSize * 2 - s.second, s.first, s.second);
         }
-        Base64URL::Block pack(Base64URL::Block src)
+        // Returns the magnitude of a non-negative INTEGER without leading zeros.
+        static std::pair<const unsigned char*, size_t> unpackInteger(const unsigned char* src, size_t size, size_t& pos)
         {
-            // Broken signature here is a validation error
-            if (src.size() != m_primeSize * 2)
-                throw JWT::ValidationError("Signature size is inconsistent with the field prime size (p: " + std::to_string(m_primeSize) + ", 2p: " + std::to_string(m_primeSize * 2) + ", s: " + std::to_string(src.size()) + ").");
-
-            auto r = BN_bin2bn(src.data<const unsigned char*>(), m_primeSize, nullptr);
-            auto s = BN_bin2bn(src.dataAt<const unsigned char*>(m_primeSize), m_primeSize, nullptr);
-
-            SigPtr sig(ECDSA_SIG_new());
-            ECDSA_SIG_set0(sig.get(), r, s);
-
-            unsigned char* ptr = nullptr;
-            auto sigSize = i2d_ECDSA_SIG(sig.get(), &ptr);
-            if (ptr == nullptr || sigSize <= 0)
-                throw Key::Error("Can't convert signature to DER encoding. " + Utils::OPENSSLError());
-
-            auto res = Base64URL::Block::fromRaw(ptr, sigSize);
-
-            OPENSSL_free(ptr);
-
-            return res;
+            if (size - pos < 2 || src[pos] != 0x02 || src[pos + 1] > 0x7F || src[pos + 1] > size - pos - 2)
+                throw Key::Error("Can't unpack DER-encoded signature.");
+            const unsigned char* value = src + pos + 2;
+            size_t length = src[pos + 1];
+            pos += 2 + length;
+            while (length > 0 && value[0] == 0)
+            {
+                ++value;
+                --length;
+            }
+            return {value, length};
+        }
+        size_t pack(const unsigned char* src, unsigned char* dest) const
+        {
+            const auto rSize = integerSize(src, m_primeSize);
+            const auto sSize = integerSize(src + m_primeSize, m_primeSize);
+            const auto length = 2 + rSize + 2 + sSize;
+            size_t pos = 0;
+            dest[pos++] = 0x30;
+            if (length > 0x7F)
+                dest[pos++] = 0x81;
+            dest[pos++] = static_cast<unsigned char>(length);
+            pos += packInteger(src, m_primeSize, rSize, dest + pos);
+            pos += packInteger(src + m_primeSize, m_primeSize, sSize, dest + pos);
+            return pos;
+        }
+        // Size of the minimal INTEGER encoding of a big-endian unsigned number.
+        static size_t integerSize(const unsigned char* src, size_t size) noexcept
+        {
+            size_t zeros = 0;
+            while (zeros + 1 < size && src[zeros] == 0)
+                ++zeros;
+            return size - zeros + ((src[zeros] & 0x80) != 0 ? 1 : 0);
+        }
+        static size_t packInteger(const unsigned char* src, size_t size, size_t integerSize, unsigned char* dest) noexcept
+        {
+            dest[0] = 0x02;
+            dest[1] = static_cast<unsigned char>(integerSize);
+            if (integerSize > size)
+            {
+                dest[2] = 0;
+                memcpy(dest + 3, src, size);
+            }
+            else
+                memcpy(dest + 2, src + size - integerSize, integerSize);
+            return 2 + integerSize;
         }
         static size_t primeSize(const Utils::EVPKeyPtr& key)
         {
@@ -4,7 +4,16 @@
 #include "utils.h"
 #include "base64url.h"
 
+#include <array>
+
 #include <openssl/evp.h>
+#include <openssl/opensslv.h> // OPENSSL_VERSION_NUMBER
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h> // OSSL_MAC_PARAM_DIGEST
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
 
 namespace JWTXX
 {
@@ -14,46 +23,109 @@ namespace Keys
 class HMAC : public Key::Impl
 {
     public:
-        HMAC(const EVP_MD* digest, const std::string& keyData) noexcept
-            : m_digest(digest), m_data(keyData)
+        HMAC(const char* digest, const std::string& keyData, const Key::LibraryContext& context)
+            : m_ctx(init(digest, keyData, context)),
+              m_size(macSize(m_ctx))
         {
         }
 
         std::string sign(const void* data, size_t size) override
         {
-            Utils::EVPMDCTXPtr ctx(EVP_MD_CTX_create());
+            MAC mac;
+            const auto macSize = compute(data, size, mac);
+            return Base64URL::encode(mac.data(), macSize);
+        }
+        bool verify(const void* data, size_t size, std::string_view signature) override
+        {
+            // Malformed signatures and signatures of a wrong size are rejected before computing the MAC.
+            if (signature.size() != Base64URL::encodedSize(m_size))
+                return false;
+            MAC expected;
+            size_t expectedSize = 0;
+            if (!Base64URL::decodeInto(signature, expected, expectedSize))
+                return false;
+            MAC mac;
+            const auto macSize = compute(data, size, mac);
+            return macSize == expectedSize && CRYPTO_memcmp(mac.data(), expected.data(), macSize) == 0;
+        }
+    private:
+        using MAC = std::array<unsigned char, EVP_MAX_MD_SIZE>;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        using Context = Utils::EVPMACCTXPtr;
+#else
+        using Context = Utils::HMACCTXPtr;
+#endif
+
+        // Keyed HMAC state (ipad/opad already hashed), never updated, only cloned for each operation.
+        Context m_ctx;
+        size_t m_size;
+
+        static Context init(const char* digest, const std::string& keyData, const Key::LibraryContext& context)
+        {
+            const auto* key = reinterpret_cast<const unsigned char*>(keyData.c_str());
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            const auto mac = Utils::fetchHMAC(context);
+            if (!mac)
+                throw Key::Error("Can't fetch HMAC implementation. " + Utils::OPENSSLError());
+            Context ctx(EVP_MAC_CTX_new(mac.get()));
             if (!ctx)
-                throw Key::Error("Can't create sign context. " + Utils::OPENSSLError());
-            if (EVP_DigestInit_ex(ctx.get(), m_digest, nullptr) != 1)
-                throw Key::Error("Can't init sign context. " + Utils::OPENSSLError());
-            Utils::EVPKeyPtr key(EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, nullptr,
-                                 reinterpret_cast<const unsigned char*>(m_data.c_str()), m_data.size()));
-            if (!key)
+                throw Key::Error("Can't create HMAC context. " + Utils::OPENSSLError());
+            // The digest is fetched here, once, using the same property query.
+            std::array<OSSL_PARAM, 3> params{
+                OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>(digest), 0),
+                OSSL_PARAM_construct_end(),
+                OSSL_PARAM_construct_end()
+            };
+            if (!context.propertyQuery.empty())
+                params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_PROPERTIES, const_cast<char*>(context.propertyQuery.c_str()), 0);
+            if (EVP_MAC_init(ctx.get(), key, keyData.size(), params.data()) != 1)
                 throw Key::Error("Can't create HMAC key. " + Utils::OPENSSLError());
-            if (EVP_DigestSignInit(ctx.get(), nullptr, m_digest, nullptr, key.get()) != 1)
-                throw Key::Error("Can't init sign context. " + Utils::OPENSSLError());
-            if (EVP_DigestSignUpdate(ctx.get(), data, size) != 1)
+#else
+            const auto* md = EVP_get_digestbyname(digest);
+            if (md == nullptr)
+                throw Key::Error("Unknown digest '" + std::string(digest) + "'.");
+            Context ctx(HMAC_CTX_new());
+            if (!ctx)
+                throw Key::Error("Can't create HMAC context. " + Utils::OPENSSLError());
+            if (HMAC_Init_ex(ctx.get(), key, static_cast<int>(keyData.size()), md, nullptr) != 1)
+                throw Key::Error("Can't create HMAC key. " + Utils::OPENSSLError());
+#endif
+            return ctx;
+        }
+
+        static size_t macSize(const Context& ctx) noexcept
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            return EVP_MAC_CTX_get_mac_size(ctx.get());
+#else
+            return HMAC_size(ctx.get());
+#endif
+        }
+
+        size_t compute(const void* data, size_t size, MAC& mac)
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            Context ctx(EVP_MAC_CTX_dup(m_ctx.get()));
+            if (!ctx)
+                throw Key::Error("Can't create sign context. " + Utils::OPENSSLError());
+            if (EVP_MAC_update(ctx.get(), static_cast<const unsigned char*>(data), size) != 1)
                 throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
             size_t res = 0;
-            if (EVP_DigestSignFinal(ctx.get(), nullptr, &res) != 1)
+            if (EVP_MAC_final(ctx.get(), mac.data(), &res, mac.size()) != 1)
                 throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
-            if (res == 0)
-                return {};
-            Base64URL::Block block(res);
-            if (EVP_DigestSignFinal(ctx.get(), block.data<unsigned char*>(), &res) != 1)
+            return res;
+#else
+            Context ctx(HMAC_CTX_new());
+            if (!ctx || HMAC_CTX_copy(ctx.get(), m_ctx.get()) != 1)
+                throw Key::Error("Can't create sign context. " + Utils::OPENSSLError());
+            if (HMAC_Update(ctx.get(), static_cast<const unsigned char*>(data), size) != 1)
                 throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
-            return Base64URL::encode(block.shrink(res));
-        }
-        bool verify(const void* data, size_t size, const std::string& signature) override
-        {
-            const auto ds = sign(data, size);
-            if (ds.length() != signature.length())
-                return false;
-            return CRYPTO_memcmp(ds.c_str(), signature.c_str(), ds.length()) == 0;
+            unsigned int res = 0;
+            if (HMAC_Final(ctx.get(), mac.data(), &res) != 1)
+                throw Key::Error("Can't sign data. " + Utils::OPENSSLError());
+            return res;
+#endif
         }
-    private:
-        const EVP_MD* m_digest;
-        std::string m_data;
 };
 
 }
@@ -3,20 +3,41 @@
 #include "jwtxx/jwt.h"
 
 #include <unordered_map>
+#include <vector>
+#include <charconv> // std::from_chars, std::to_chars
+#include <iterator> // std::next, std::make_move_iterator
 #include <memory> // std::unique_ptr
 #include <utility> // std::pair<>::first, std::pair<>::second
 #include <type_traits> // std::is_same_v, std::decay_t
+#include <array>
 
 #include <cstdlib> // free
+#include <cstdio> // snprintf
 #include <cstdint>
+#include <cmath> // std::isfinite
 
+#ifdef USE_JANSSON
 #include <jansson.h>
+#endif
 
 using JWTXX::Value;
+using JWTXX::JWT;
 
 namespace
 {
 
+[[noreturn]] void depthExceeded(size_t maxDepth)
+{
+    throw JWTXX::JSONLimitError("JSON is nested deeper than " + std::to_string(maxDepth) + " levels.");
+}
+
+[[noreturn]] void membersExceeded(size_t maxMembers)
+{
+    throw JWTXX::JSONLimitError("JSON has more than " + std::to_string(maxMembers) + " values.");
+}
+
+#ifdef USE_JANSSON
+
 struct JSONDeleter
 {
     void operator()(json_t* obj) const noexcept { json_decref(obj); }
@@ -31,6 +52,29 @@ std::string dumpNode(const json_t* node) noexcept
     return res;
 }
 
+// Checks an array or an object before it is converted, the conversion allocates for every value.
+void checkLimits(const json_t* node, size_t depth, size_t maxDepth, size_t maxMembers, size_t& count)
+{
+    if (depth > maxDepth)
+        depthExceeded(maxDepth);
+    const auto check = [&](const json_t* child)
+                       {
+                           if (++count > maxMembers)
+                               membersExceeded(maxMembers);
+                           if (json_is_array(child) || json_is_object(child))
+                               checkLimits(child, depth + 1, maxDepth, maxMembers, count);
+                       };
+    if (json_is_array(node))
+    {
+        for (size_t i = 0; i < json_array_size(node); ++i)
+            check(json_array_get(node, i));
+        return;
+    }
+    auto* n = const_cast<json_t*>(node);
+    for (auto* it = json_object_iter(n); it != nullptr; it = json_object_iter_next(n, it))
+        check(json_object_iter_value(it));
+}
+
 Value arrayToValue(const json_t* node) noexcept;
 Value objectToValue(const json_t* node) noexcept;
 
@@ -84,6 +128,8 @@ json_t* toJSONT(const Value& value) noexcept
             return json_false();
         } else if constexpr (std::is_same_v<T, int64_t>) {
             return json_integer(v);
+        } else if constexpr (std::is_same_v<T, double>) {
+            return json_real(v);
         } else if constexpr (std::is_same_v<T, std::string>) {
             return json_stringn(v.c_str(), v.length());
         } else if constexpr (std::is_same_v<T, Value::Array>) {
@@ -101,25 +147,642 @@ json_t* toJSONT(const Value& value) noexcept
     });
 }
 
+#else
+
+// Mirrors JSON_PARSER_MAX_DEPTH of jansson.
+constexpr size_t maxDepth = 2048;
+
+// Returns the length of a valid UTF-8 sequence at 'pos', 0 if the sequence is invalid.
+size_t utf8Length(std::string_view data, size_t pos) noexcept
+{
+    const auto c = static_cast<uint8_t>(data[pos]);
+    if (c < 0x80)
+        return 1;
+    size_t length = 0;
+    uint32_t cp = 0;
+    if (c < 0xC2)
+        return 0;
+    if (c < 0xE0)
+    {
+        length = 2;
+        cp = c & 0x1FU;
+    }
+    else if (c < 0xF0)
+    {
+        length = 3;
+        cp = c & 0x0FU;
+    }
+    else if (c < 0xF5)
+    {
+        length = 4;
+        cp = c & 0x07U;
+    }
+    else
+        return 0;
+    if (pos + length > data.size())
+        return 0;
+    for (size_t i = 1; i < length; ++i)
+    {
+        const auto cc = static_cast<uint8_t>(data[pos + i]);
+        if ((cc & 0xC0U) != 0x80)
+            return 0;
+        cp = (cp << 6) | (cc & 0x3FU);
+    }
+    if (length == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF)))
+        return 0;
+    if (length == 4 && (cp < 0x10000 || cp > 0x10FFFF))
+        return 0;
+    return length;
+}
+
+void appendUTF8(std::string& dest, uint32_t cp)
+{
+    if (cp < 0x80)
+        dest += static_cast<char>(cp);
+    else if (cp < 0x800)
+    {
+        dest += static_cast<char>(0xC0 | (cp >> 6));
+        dest += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        dest += static_cast<char>(0xE0 | (cp >> 12));
+        dest += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        dest += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        dest += static_cast<char>(0xF0 | (cp >> 18));
+        dest += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        dest += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        dest += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+std::string hex(uint32_t value, int width)
+{
+    std::array<char, 16> buf{};
+    const auto size = std::snprintf(buf.data(), buf.size(), "%0*X", width, value);
+    return std::string(buf.data(), size);
+}
+
+bool isDigit(char ch) noexcept
+{
+    return ch >= '0' && ch <= '9';
+}
+
+// Tells overflow from underflow for a valid JSON number that is out of the double range:
+// the decimal exponent of its first significant digit is positive only for overflow.
+bool overflows(std::string_view number) noexcept
+{
+    constexpr long saturation = 1000000000;
+    long order = -1;
+    bool significant = false;
+    size_t pos = number.size() > 0 && number[0] == '-' ? 1 : 0;
+    for (; pos < number.size() && isDigit(number[pos]); ++pos)
+        if (significant || number[pos] != '0')
+        {
+            significant = true;
+            ++order;
+        }
+    if (pos < number.size() && number[pos] == '.')
+        for (++pos; pos < number.size() && isDigit(number[pos]); ++pos)
+            if (!significant)
+            {
+                if (number[pos] != '0')
+                    significant = true;
+                else
+                    --order;
+            }
+    if (pos < number.size() && (number[pos] == 'e' || number[pos] == 'E'))
+    {
+        ++pos;
+        const bool negative = pos < number.size() && number[pos] == '-';
+        if (pos < number.size() && (number[pos] == '+' || number[pos] == '-'))
+            ++pos;
+        long exponent = 0;
+        for (; pos < number.size() && isDigit(number[pos]); ++pos)
+            if (exponent < saturation)
+                exponent = exponent * 10 + (number[pos] - '0');
+        order += negative ? -exponent : exponent;
+    }
+    return order >= 0;
+}
+
+// Single-pass recursive descent parser producing Value directly.
+// Array elements and object members are collected on shared scratch stacks,
+// so each container is built with its final size in one go.
+class Parser
+{
+    public:
+        Parser(std::string_view data, size_t depthLimit, size_t memberLimit) noexcept
+            : m_data(data), m_pos(0), m_maxDepth(depthLimit), m_maxMembers(memberLimit), m_count(0)
+        {
+        }
+
+        Value::Object parse()
+        {
+            skipSpace();
+            if (peek() == '[')
+            {
+                parseArray(1);
+                finish();
+                throw JWT::ParseError("Not a JSON object.");
+            }
+            if (peek() != '{')
+                error("'[' or '{' expected");
+            auto res = parseObject(1);
+            finish();
+            return res;
+        }
+
+    private:
+        std::string_view m_data;
+        size_t m_pos;
+        size_t m_maxDepth;
+        size_t m_maxMembers;
+        size_t m_count;
+        std::vector<Value> m_values;
+        std::vector<std::pair<std::string, Value>> m_members;
+
+        char peek() const noexcept { return m_pos < m_data.size() ? m_data[m_pos] : '\0'; }
+
+        [[noreturn]] void error(const std::string& reason) const
+        {
+            // Like jansson, report the position past the offending character.
+            const auto eof = m_pos >= m_data.size();
+            const auto near = eof ? std::string("end of file") : "'" + std::string(1, m_data[m_pos]) + "'";
+            throw JWT::ParseError("Error parsing json at position " + std::to_string(eof ? m_data.size() : m_pos + 1) + " in '" + std::string(m_data) + "', reason: " + reason + " near " + near);
+        }
+
+        void finish()
+        {
+            skipSpace();
+            if (m_pos != m_data.size())
+                error("end of file expected");
+        }
+
+        void skipSpace() noexcept
+        {
+            while (m_pos < m_data.size() && (m_data[m_pos] == ' ' || m_data[m_pos] == '\t' || m_data[m_pos] == '\n' || m_data[m_pos] == '\r'))
+                ++m_pos;
+        }
+
+        Value parseValue(size_t depth)
+        {
+            if (++m_count > m_maxMembers)
+                membersExceeded(m_maxMembers);
+            switch (peek())
+            {
+                case '{': return Value(parseObject(depth + 1));
+                case '[': return parseArray(depth + 1);
+                case '"': return Value(parseString());
+                case 't': literal("true"); return Value(true);
+                case 'f': literal("false"); return Value(false);
+                case 'n': literal("null"); return Value{};
+                case '}':
+                case ']':
+                case ',':
+                case ':':
+                    error("unexpected token");
+                default:
+                    if (peek() == '-' || isDigit(peek()))
+                        return parseNumber();
+                    error(m_pos < m_data.size() ? "invalid token" : "unexpected token");
+            }
+        }
+
+        void literal(std::string_view expected)
+        {
+            if (m_data.substr(m_pos, expected.size()) != expected)
+                error("invalid token");
+            m_pos += expected.size();
+        }
+
+        void checkDepth(size_t depth) const
+        {
+            if (depth > m_maxDepth)
+                depthExceeded(m_maxDepth);
+            if (depth > maxDepth)
+                error("maximum parsing depth reached");
+        }
+
+        Value::Object parseObject(size_t depth)
+        {
+            checkDepth(depth);
+            ++m_pos; // '{'
+            const auto base = m_members.size();
+            skipSpace();
+            if (peek() == '}')
+            {
+                ++m_pos;
+                return {};
+            }
+            while (true)
+            {
+                if (peek() != '"')
+                    error("string or '}' expected");
+                auto key = parseString();
+                skipSpace();
+                if (peek() != ':')
+                    error("':' expected");
+                ++m_pos;
+                skipSpace();
+                auto value = parseValue(depth);
+                m_members.emplace_back(std::move(key), std::move(value));
+                skipSpace();
+                if (peek() == '}')
+                {
+                    ++m_pos;
+                    break;
+                }
+                if (peek() != ',')
+                    error("'}' expected");
+                ++m_pos;
+                skipSpace();
+            }
+            Value::Object res;
+            res.reserve(m_members.size() - base);
+            // Like jansson, the last of duplicate keys wins.
+            for (auto it = std::next(m_members.begin(), static_cast<std::ptrdiff_t>(base)); it != m_members.end(); ++it)
+                res.insert_or_assign(std::move(it->first), std::move(it->second));
+            m_members.erase(std::next(m_members.begin(), static_cast<std::ptrdiff_t>(base)), m_members.end());
+            return res;
+        }
+
+        Value parseArray(size_t depth)
+        {
+            checkDepth(depth);
+            ++m_pos; // '['
+            const auto base = m_values.size();
+            skipSpace();
+            if (peek() == ']')
+            {
+                ++m_pos;
+                return Value(Value::Array{});
+            }
+            while (true)
+            {
+                auto value = parseValue(depth);
+                m_values.push_back(std::move(value));
+                skipSpace();
+                if (peek() == ']')
+                {
+                    ++m_pos;
+                    break;
+                }
+                if (peek() != ',')
+                    error("']' expected");
+                ++m_pos;
+                skipSpace();
+            }
+            const auto first = std::next(m_values.begin(), static_cast<std::ptrdiff_t>(base));
+            Value::Array res(std::make_move_iterator(first), std::make_move_iterator(m_values.end()));
+            m_values.erase(first, m_values.end());
+            return Value(std::move(res));
+        }
+
+        uint32_t parseHex4()
+        {
+            if (m_pos + 4 > m_data.size())
+                error("invalid escape");
+            uint32_t res = 0;
+            for (size_t i = 0; i < 4; ++i)
+            {
+                const auto ch = m_data[m_pos++];
+                res <<= 4;
+                if (isDigit(ch))
+                    res |= static_cast<uint32_t>(ch - '0');
+                else if (ch >= 'a' && ch <= 'f')
+                    res |= static_cast<uint32_t>(ch - 'a' + 10);
+                else if (ch >= 'A' && ch <= 'F')
+                    res |= static_cast<uint32_t>(ch - 'A' + 10);
+                else
+                {
+                    --m_pos;
+                    error("invalid escape");
+                }
+            }
+            return res;
+        }
+
+        void parseEscape(std::string& dest)
+        {
+            ++m_pos; // '\\'
+            const auto ch = peek();
+            ++m_pos;
+            switch (ch)
+            {
+                case '"': dest += '"'; return;
+                case '\\': dest += '\\'; return;
+                case '/': dest += '/'; return;
+                case 'b': dest += '\b'; return;
+                case 'f': dest += '\f'; return;
+                case 'n': dest += '\n'; return;
+                case 'r': dest += '\r'; return;
+                case 't': dest += '\t'; return;
+                case 'u': break;
+                default:
+                    --m_pos;
+                    error("invalid escape");
+            }
+            auto cp = parseHex4();
+            if (cp >= 0xD800 && cp <= 0xDBFF)
+            {
+                // Surrogate pair
+                if (m_data.substr(m_pos, 2) != "\\u")
+                    error("invalid Unicode '\\u" + hex(cp, 4) + "'");
+                m_pos += 2;
+                const auto low = parseHex4();
+                if (low < 0xDC00 || low > 0xDFFF)
+                    error("invalid Unicode '\\u" + hex(cp, 4) + "\\u" + hex(low, 4) + "'");
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if (cp >= 0xDC00 && cp <= 0xDFFF)
+                error("invalid Unicode '\\u" + hex(cp, 4) + "'");
+            else if (cp == 0)
+                error("\\u0000 is not allowed");
+            appendUTF8(dest, cp);
+        }
+
+        std::string parseString()
+        {
+            ++m_pos; // '"'
+            std::string res;
+            auto start = m_pos;
+            while (true)
+            {
+                if (m_pos >= m_data.size())
+                    error("premature end of input");
+                const auto ch = static_cast<uint8_t>(m_data[m_pos]);
+                if (ch == '"')
+                    break;
+                if (ch < 0x20)
+                    error("control character 0x" + hex(ch, 1));
+                if (ch == '\\')
+                {
+                    res.append(m_data.data() + start, m_pos - start);
+                    parseEscape(res);
+                    start = m_pos;
+                    continue;
+                }
+                if (ch < 0x80)
+                {
+                    ++m_pos;
+                    continue;
+                }
+                const auto length = utf8Length(m_data, m_pos);
+                if (length == 0)
+                    error("unable to decode byte 0x" + hex(ch, 1));
+                m_pos += length;
+            }
+            res.append(m_data.data() + start, m_pos - start);
+            ++m_pos; // '"'
+            return res;
+        }
+
+        Value parseNumber()
+        {
+            const auto start = m_pos;
+            bool real = false;
+            if (peek() == '-')
+                ++m_pos;
+            if (peek() == '0')
+                ++m_pos;
+            else if (isDigit(peek()))
+                while (isDigit(peek()))
+                    ++m_pos;
+            else
+                error("invalid token");
+            if (peek() == '.')
+            {
+                real = true;
+                ++m_pos;
+                if (!isDigit(peek()))
+                    error("invalid token");
+                while (isDigit(peek()))
+                    ++m_pos;
+            }
+            if (peek() == 'e' || peek() == 'E')
+            {
+                real = true;
+                ++m_pos;
+                if (peek() == '+' || peek() == '-')
+                    ++m_pos;
+                if (!isDigit(peek()))
+                    error("invalid token");
+                while (isDigit(peek()))
+                    ++m_pos;
+            }
+            const auto* first = m_data.data() + start;
+            const auto* last = m_data.data() + m_pos;
+            if (!real)
+            {
+                int64_t value = 0;
+                if (std::from_chars(first, last, value).ec != std::errc{})
+                {
+                    m_pos = start;
+                    error("too big integer");
+                }
+                return Value(value);
+            }
+            double value = 0;
+            if (std::from_chars(first, last, value).ec != std::errc{})
+            {
+                if (overflows(std::string_view(first, last - first)))
+                {
+                    m_pos = start;
+                    error("real number overflow");
+                }
+                // Underflow, rounds to zero like strtod does.
+                value = *first == '-' ? -0.0 : 0.0;
+            }
+            return Value::number(value);
+        }
+};
+
+// Serializes Value straight into a string, compact like JSON_COMPACT of jansson.
+class Writer
+{
+    public:
+        explicit Writer(std::string& dest) noexcept : m_dest(dest) {}
+
+        void write(const Value::Object& object)
+        {
+            m_dest += '{';
+            bool first = true;
+            for (const auto& item : object)
+            {
+                if (!first)
+                    m_dest += ',';
+                first = false;
+                writeString(item.first);
+                m_dest += ':';
+                write(item.second);
+            }
+            m_dest += '}';
+        }
+
+        void write(const Value& value)
+        {
+            value.visit([this](auto&& v) {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, Value::Null>) {
+                    m_dest += "null";
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    m_dest += v ? "true" : "false";
+                } else if constexpr (std::is_same_v<T, int64_t>) {
+                    writeNumber(v);
+                } else if constexpr (std::is_same_v<T, double>) {
+                    writeReal(v);
+                } else if constexpr (std::is_same_v<T, std::string>) {
+                    writeString(v);
+                } else if constexpr (std::is_same_v<T, Value::Array>) {
+                    m_dest += '[';
+                    for (size_t i = 0; i < v.size(); ++i)
+                    {
+                        if (i != 0)
+                            m_dest += ',';
+                        write(v[i]);
+                    }
+                    m_dest += ']';
+                } else if constexpr (std::is_same_v<T, Value::Object>) {
+                    write(v);
+                }
+            });
+        }
+
+        // Upper bound of the serialized size unless strings need escaping.
+        static size_t estimate(const Value::Object& object) noexcept
+        {
+            size_t res = 2;
+            for (const auto& item : object)
+                res += item.first.size() + 4 + estimate(item.second);
+            return res;
+        }
+
+    private:
+        std::string& m_dest;
+
+        static size_t estimate(const Value& value) noexcept
+        {
+            return value.visit([](auto&& v) -> size_t {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::string>) {
+                    return v.size() + 2;
+                } else if constexpr (std::is_same_v<T, Value::Array>) {
+                    size_t res = 2;
+                    for (const auto& i : v)
+                        res += estimate(i) + 1;
+                    return res;
+                } else if constexpr (std::is_same_v<T, Value::Object>) {
+                    return estimate(v);
+                } else {
+                    return 24; // Any number, bool or null
+                }
+            });
+        }
+
+        template <typename T>
+        void writeNumber(T value)
+        {
+            std::array<char, 32> buf{};
+            const auto res = std::to_chars(buf.begin(), buf.end(), value);
+            m_dest.append(buf.data(), res.ptr);
+        }
+
+        void writeReal(double value)
+        {
+            // JSON has no NaN and infinities.
+            if (!std::isfinite(value))
+            {
+                m_dest += "null";
+                return;
+            }
+            const auto pos = m_dest.size();
+            writeNumber(value);
+            // Keep it a real number when read back.
+            if (m_dest.find_first_of(".e", pos) == std::string::npos)
+                m_dest += ".0";
+        }
+
+        void writeString(std::string_view value)
+        {
+            m_dest += '"';
+            size_t start = 0;
+            size_t pos = 0;
+            while (pos < value.size())
+            {
+                const auto ch = static_cast<uint8_t>(value[pos]);
+                if (ch >= 0x20 && ch < 0x80 && ch != '"' && ch != '\\')
+                {
+                    ++pos;
+                    continue;
+                }
+                if (ch >= 0x80)
+                {
+                    const auto length = utf8Length(value, pos);
+                    if (length != 0)
+                    {
+                        pos += length;
+                        continue;
+                    }
+                }
+                m_dest.append(value.data() + start, pos - start);
+                switch (ch)
+                {
+                    case '"': m_dest += "\\\""; break;
+                    case '\\': m_dest += "\\\\"; break;
+                    case '\b': m_dest += "\\b"; break;
+                    case '\f': m_dest += "\\f"; break;
+                    case '\n': m_dest += "\\n"; break;
+                    case '\r': m_dest += "\\r"; break;
+                    case '\t': m_dest += "\\t"; break;
+                    default:
+                        // Other control characters; invalid UTF-8 is replaced to keep the output valid JSON.
+                        m_dest += "\\u" + (ch < 0x80 ? hex(ch, 4) : std::string("FFFD"));
+                }
+                start = ++pos;
+            }
+            m_dest.append(value.data() + start, pos - start);
+            m_dest += '"';
+        }
+};
+
+#endif
+
 }
 
 std::string JWTXX::toJSON(const Value::Object& data) noexcept
 {
+#ifndef USE_JANSSON
+    std::string res;
+    res.reserve(Writer::estimate(data));
+    Writer(res).write(data);
+    return res;
+#else
     const JSON root(json_object());
     for (const auto& item : data)
         json_object_set_new(root.get(), item.first.c_str(), toJSONT(item.second));
     return dumpNode(root.get());
+#endif
 }
 
-Value::Object JWTXX::fromJSON(const std::string& data)
+Value::Object JWTXX::fromJSON(std::string_view data, size_t maxDepth, size_t maxMembers)
 {
+#ifndef USE_JANSSON
+    return Parser(data, maxDepth, maxMembers).parse();
+#else
     json_error_t error;
-    const JSON root(json_loads(data.c_str(), 0, &error));
+    const JSON root(json_loadb(data.data(), data.size(), 0, &error));
     if (!root)
-        throw JWT::ParseError("Error parsing json at position " + std::to_string(error.position) + " in '" + data + "', reason: " + error.text);
+        throw JWT::ParseError("Error parsing json at position " + std::to_string(error.position) + " in '" + std::string(data) + "', reason: " + error.text);
 
     if (!json_is_object(root.get()))
         throw JWT::ParseError("Not a JSON object.");
 
+    size_t count = 0;
+    checkLimits(root.get(), 1, maxDepth, maxMembers, count);
     return toValueObject(root.get());
+#endif
 }
@@ -1,13 +1,25 @@
 #pragma once
 
+#include "jwtxx/jwt.h"
 #include "jwtxx/value.h"
 
+#include <limits>
 #include <string>
+#include <string_view>
+
+#include <cstddef>
 
 namespace JWTXX
 {
 
+// Thrown by fromJSON when the data exceeds the depth or the number of values it is allowed.
+struct JSONLimitError : JWT::ParseError
+{
+    explicit JSONLimitError(const std::string& message) noexcept : JWT::ParseError(message) {}
+};
+
 std::string toJSON(const Value::Object& data) noexcept;
-Value::Object fromJSON(const std::string& data);
+// Without limits the depth is still capped, like in jansson.
+Value::Object fromJSON(std::string_view data, size_t maxDepth = std::numeric_limits<size_t>::max(), size_t maxMembers = std::numeric_limits<size_t>::max());
 
 }
@@ -1,4 +1,7 @@
 #include "jwtxx/jwt.h"
+#include "jwtxx/keyset.h"
+#include "jwtxx/keyregistry.h"
+#include "jwtxx/keystore.h"
 
 #include "keyimpl.h"
 #include "nonekey.h"
@@ -11,44 +14,141 @@
 
 #include <array>
 #include <iterator> // std::end
-#include <tuple> // std::get
+#include <tuple> // std::ignore
+#include <string_view>
 #include <utility> // std::move
 #include <stdexcept> // std::runtime_error, std::logic_error
 
 #include <ctime>
+#include <time.h> // clock_gettime, CLOCK_REALTIME_COARSE
 
 #include <openssl/evp.h>
 #include <openssl/crypto.h> // CRYPTO_cleanup_all_ex_data
 #include <openssl/err.h>
+#include <openssl/opensslv.h> // OPENSSL_VERSION_NUMBER
 
 using JWTXX::Algorithm;
 using JWTXX::Validator;
 using JWTXX::Value;
 using JWTXX::Key;
 using JWTXX::JWT;
+using JWTXX::Verifier;
+using JWTXX::ValidationOrder;
+using JWTXX::ErrorCode;
+using JWTXX::KeySet;
+using JWTXX::KeyRegistry;
+using JWTXX::KeyStore;
+using JWTXX::ValidatorSet;
+using JWTXX::DecodeResult;
 
 namespace Keys = JWTXX::Keys;
 namespace Validate = JWTXX::Validate;
 namespace Utils = JWTXX::Utils;
 namespace Base64URL = JWTXX::Base64URL;
 
+namespace JWTXX
+{
+
+// Failures found by the library keep raw values, ValidationResult::message() formats them on request.
+// Tokens are rejected without formatting anything, which matters for unauthenticated traffic.
+struct FailureDetails
+{
+    static ValidationResult make(ErrorCode code, const char* name) noexcept
+    {
+        ValidationResult res(code, {});
+        res.m_name = name;
+        return res;
+    }
+
+    static ValidationResult mismatch(Algorithm expected, Algorithm actual) noexcept
+    {
+        auto res = make(ErrorCode::AlgorithmMismatch, "alg");
+        res.m_expected = expected;
+        res.m_actual = actual;
+        return res;
+    }
+
+    static ValidationResult notAllowed(Algorithm alg) noexcept
+    {
+        auto res = make(ErrorCode::AlgorithmNotAllowed, "alg");
+        res.m_actual = alg;
+        return res;
+    }
+
+    static ValidationResult invalidAlgorithm(std::string&& name) noexcept
+    {
+        auto res = make(ErrorCode::InvalidAlgorithm, "alg");
+        res.m_text = std::move(name);
+        return res;
+    }
+
+    static ValidationResult time(ErrorCode code, const char* name, std::time_t time, std::time_t now) noexcept
+    {
+        auto res = make(code, name);
+        res.m_value = time;
+        res.m_bound = now;
+        return res;
+    }
+
+    static ValidationResult claim(const char* name, const std::string& expected, const Value& actual) noexcept
+    {
+        auto res = make(ErrorCode::InvalidClaim, name);
+        res.m_text = expected;
+        res.m_claim = actual;
+        return res;
+    }
+
+    static ValidationResult tooLong(const char* name, size_t size, size_t limit) noexcept
+    {
+        auto res = make(ErrorCode::LimitExceeded, name);
+        res.m_value = static_cast<int64_t>(size);
+        res.m_bound = static_cast<int64_t>(limit);
+        return res;
+    }
+
+    static ValidationResult unknownKey(std::string&& kid, Algorithm alg) noexcept
+    {
+        auto res = make(ErrorCode::UnknownKey, "kid");
+        res.m_text = std::move(kid);
+        res.m_actual = alg;
+        return res;
+    }
+};
+
+}
+
+using JWTXX::FailureDetails;
+
 namespace
 {
 
-Key::Impl* createKey(Algorithm alg, const std::string& keyData, const Key::PasswordCallback& cb)
+template <typename T>
+Key::Impl* createAsymmetricKey(const char* digest, std::string_view keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context, bool inMemory)
 {
+    if (inMemory)
+        return new T(digest, keyData, cb, context, Keys::Asymmetric::InMemory{});
+    return new T(digest, std::string(keyData), cb, context);
+}
+
+// Digests are passed by name, keys fetch them explicitly from their library context.
+Key::Impl* createKey(Algorithm alg, std::string_view keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context, bool inMemory = false)
+{
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+    if (context.libCtx != nullptr || !context.propertyQuery.empty())
+        throw Key::Error("Library contexts and property queries require OpenSSL 3.0 or newer.");
+#endif
     switch (alg)
     {
         case Algorithm::none: return new Keys::None{};
-        case Algorithm::HS256: return new Keys::HMAC(EVP_sha256(), keyData);
-        case Algorithm::HS384: return new Keys::HMAC(EVP_sha384(), keyData);
-        case Algorithm::HS512: return new Keys::HMAC(EVP_sha512(), keyData);
-        case Algorithm::RS256: return new Keys::RSA(EVP_sha256(), keyData, cb);
-        case Algorithm::RS384: return new Keys::RSA(EVP_sha384(), keyData, cb);
-        case Algorithm::RS512: return new Keys::RSA(EVP_sha512(), keyData, cb);
-        case Algorithm::ES256: return new Keys::EC(EVP_sha256(), keyData, cb);
-        case Algorithm::ES384: return new Keys::EC(EVP_sha384(), keyData, cb);
-        case Algorithm::ES512: return new Keys::EC(EVP_sha512(), keyData, cb);
+        case Algorithm::HS256: return new Keys::HMAC("SHA256", std::string(keyData), context);
+        case Algorithm::HS384: return new Keys::HMAC("SHA384", std::string(keyData), context);
+        case Algorithm::HS512: return new Keys::HMAC("SHA512", std::string(keyData), context);
+        case Algorithm::RS256: return createAsymmetricKey<Keys::RSA>("SHA256", keyData, cb, context, inMemory);
+        case Algorithm::RS384: return createAsymmetricKey<Keys::RSA>("SHA384", keyData, cb, context, inMemory);
+        case Algorithm::RS512: return createAsymmetricKey<Keys::RSA>("SHA512", keyData, cb, context, inMemory);
+        case Algorithm::ES256: return createAsymmetricKey<Keys::EC>("SHA256", keyData, cb, context, inMemory);
+        case Algorithm::ES384: return createAsymmetricKey<Keys::EC>("SHA384", keyData, cb, context, inMemory);
+        case Algorithm::ES512: return createAsymmetricKey<Keys::EC>("SHA512", keyData, cb, context, inMemory);
     }
     throw Key::Error("Unknown algorithm: <" + std::to_string(static_cast<int>(alg)) + ">");
 }
@@ -66,18 +166,18 @@ JWTXX::ValidationResult validTime(const Value& value, F&& next) noexcept
             const auto s = value.getString();
             auto t = std::stoull(s, &pos);
             if (pos != s.length())
-                return JWTXX::ValidationResult::failure("Invalid time value. Should be a positive integer value, got '" + s + "'.");
+                return JWTXX::ValidationResult::failure(ErrorCode::InvalidTime, "Invalid time value. Should be a positive integer value, got '" + s + "'.");
             return next(t);
         }
-        return JWTXX::ValidationResult::failure("Invalid time value. Should be a positive integer value, got '" + value.toString() + "'.");
+        return JWTXX::ValidationResult::failure(ErrorCode::InvalidTime, "Invalid time value. Should be a positive integer value, got '" + value.toString() + "'.");
     }
     catch (const Value::Error&)
     {
-        return JWTXX::ValidationResult::failure("Invalid time value. Should be a positive integer value, got '" + value.toString() + "'.");
+        return JWTXX::ValidationResult::failure(ErrorCode::InvalidTime, "Invalid time value. Should be a positive integer value, got '" + value.toString() + "'.");
     }
     catch (const std::logic_error&)
     {
-        return JWTXX::ValidationResult::failure("Invalid time value. Should be a positive integer value, got '" + value.toString() + "'.");
+        return JWTXX::ValidationResult::failure(ErrorCode::InvalidTime, "Invalid time value. Should be a positive integer value, got '" + value.toString() + "'.");
     }
 }
 
@@ -90,17 +190,13 @@ JWTXX::ValidationResult validClaim(const Value::Object& claims, const std::strin
     return next(it->second);
 }
 
-template <typename F>
-JWTXX::ValidationResult validTimeClaim(const Value::Object& claims, const std::string& claim, F&& next) noexcept
+// The name is a string literal, failures refer to it.
+JWTXX::ValidationResult checkString(const char* name, const Value& value, const std::string& validValue) noexcept
 {
-    return validClaim(claims, claim,
-                      [&](const Value& value)
-                      {
-                          return validTime(value, std::forward<F>(next));
-                      });
+    return value.isString() && value.getString() == validValue ? JWTXX::ValidationResult::ok() : FailureDetails::claim(name, validValue, value);
 }
 
-Validator stringValidator(std::string&& name,
+Validator stringValidator(const char* name,
                           std::string&& validValue) noexcept
 {
     return [=](const Value::Object& claims)
@@ -108,7 +204,7 @@ Validator stringValidator(std::string&& name,
                return validClaim(claims, name,
                                  [=](const Value& value)
                                  {
-                                     return value.isString() && value.getString() == validValue ? JWTXX::ValidationResult::ok() : JWTXX::ValidationResult::failure("'" + name + "' claim should be '" + validValue + "'. Got: " + value.toString() + ".");
+                                     return checkString(name, value, validValue);
                                  });
            };
 }
@@ -124,23 +220,129 @@ std::string formatTime(std::time_t value) noexcept
     return std::string(buf.data(), res);
 }
 
-std::string findAlg(const Value::Object& pairs)
+JWTXX::ValidationResult checkExp(const Value& value, std::time_t now, std::time_t leeway = 0) noexcept
 {
-    const auto it = pairs.find("alg");
-    if (it == pairs.end())
-        return {};
-    if (it->second.isString())
+    return validTime(value,
+                     [=](std::time_t t)
+                     {
+                         return t > now - leeway ? JWTXX::ValidationResult::ok() : FailureDetails::time(ErrorCode::Expired, "exp", t, now);
+                     });
+}
+
+JWTXX::ValidationResult checkNbf(const Value& value, std::time_t now, std::time_t leeway = 0) noexcept
+{
+    return validTime(value,
+                     [=](std::time_t t)
+                     {
+                         return t < now + leeway ? JWTXX::ValidationResult::ok() : FailureDetails::time(ErrorCode::NotYetValid, "nbf", t, now);
+                     });
+}
+
+JWTXX::ValidationResult checkIat(const Value& value, std::time_t now, std::time_t leeway = 0) noexcept
+{
+    return validTime(value,
+                     [=](std::time_t t)
+                     {
+                         return t < now + leeway ? JWTXX::ValidationResult::ok() : FailureDetails::time(ErrorCode::NotYetIssued, "iat", t, now);
+                     });
+}
+
+// Positions of the standard claims in ValidatorSet, -1 for other names. No std::string construction, unlike map lookups.
+int standardClaim(const std::string& name) noexcept
+{
+    if (name.size() != 3)
+        return -1;
+    switch (name[0])
     {
-        try
-        {
-            return it->second.getString();
-        }
-        catch (const Value::Error&)
-        {
-            throw JWT::ParseError("\"alg\" should be a string. Actual value: \"" + it->second.toString() + "\".");
-        }
+        case 'e': return name[1] == 'x' && name[2] == 'p' ? 0 : -1;
+        case 'n': return name[1] == 'b' && name[2] == 'f' ? 1 : -1;
+        case 'i':
+            if (name[1] == 'a' && name[2] == 't')
+                return 2;
+            return name[1] == 's' && name[2] == 's' ? 3 : -1;
+        case 'a': return name[1] == 'u' && name[2] == 'd' ? 4 : -1;
+        case 's': return name[1] == 'u' && name[2] == 'b' ? 5 : -1;
     }
-    throw JWT::ParseError("\"alg\" should be a string. Actual value: \"" + it->second.toString() + "\".");
+    return -1;
+}
+
+bool algFromString(std::string_view value, Algorithm& alg) noexcept
+{
+    if (value == "none") alg = Algorithm::none;
+    else if (value == "HS256") alg = Algorithm::HS256;
+    else if (value == "HS384") alg = Algorithm::HS384;
+    else if (value == "HS512") alg = Algorithm::HS512;
+    else if (value == "RS256") alg = Algorithm::RS256;
+    else if (value == "RS384") alg = Algorithm::RS384;
+    else if (value == "RS512") alg = Algorithm::RS512;
+    else if (value == "ES256") alg = Algorithm::ES256;
+    else if (value == "ES384") alg = Algorithm::ES384;
+    else if (value == "ES512") alg = Algorithm::ES512;
+    else return false;
+    return true;
+}
+
+// Outcome of the non-throwing pipeline, see FailureDetails.
+using Failure = JWTXX::ValidationResult;
+
+bool fail(Failure& failure, Failure&& res) noexcept
+{
+    failure = std::move(res);
+    return false;
+}
+
+bool fail(Failure& failure, ErrorCode code, const std::string& message)
+{
+    return fail(failure, JWTXX::ValidationResult::failure(code, message));
+}
+
+bool isParseError(ErrorCode code) noexcept
+{
+    return code == ErrorCode::InvalidStructure || code == ErrorCode::InvalidEncoding || code == ErrorCode::InvalidJSON || code == ErrorCode::InvalidAlgorithm || code == ErrorCode::LimitExceeded;
+}
+
+[[noreturn]] void throwFailure(const Failure& failure)
+{
+    const auto message = failure.message();
+    if (isParseError(failure.code()))
+        throw JWT::ParseError(message);
+    throw JWT::ValidationError(message);
+}
+
+bool findAlg(const Value::Object& pairs, Algorithm& alg, Failure& failure)
+{
+    alg = Algorithm::none;
+    const auto it = pairs.find("alg");
+    if (it == pairs.end())
+        return true;
+    if (!it->second.isString())
+        return fail(failure, ErrorCode::InvalidAlgorithm, "\"alg\" should be a string. Actual value: \"" + it->second.toString() + "\".");
+    auto name = it->second.getString();
+    if (name.empty() || algFromString(name, alg))
+        return true;
+    return fail(failure, FailureDetails::invalidAlgorithm(std::move(name)));
+}
+
+struct TokenParts
+{
+    std::string_view header;
+    std::string_view claims;
+    std::string_view signature;
+    std::string_view signingInput;
+};
+
+bool splitToken(std::string_view token, TokenParts& parts) noexcept
+{
+    const auto pos = token.find('.');
+    if (pos == std::string_view::npos)
+        return false;
+    parts.header = token.substr(0, pos);
+    const auto spos = token.find('.', pos + 1);
+    parts.claims = token.substr(pos + 1, spos == std::string_view::npos ? std::string_view::npos : spos - pos - 1);
+    parts.signingInput = token.substr(0, spos);
+    if (spos != std::string_view::npos)
+        parts.signature = token.substr(spos + 1);
+    return true;
 }
 
 struct JWTData
@@ -148,38 +350,185 @@ struct JWTData
     Algorithm alg;
     Value::Object header;
     Value::Object claims;
-    std::string data;
-    std::string signature;
+    // Both refer to the token.
+    std::string_view data;
+    std::string_view signature;
 };
 
-JWTData parseJWT(const std::string& token)
+bool checkSize(std::string_view part, const char* name, size_t maxSize, Failure& failure)
 {
-    auto parts = Utils::split(token);
-    auto h = JWTXX::fromJSON(Base64URL::decode(std::get<0>(parts)).toString());
-    auto c = JWTXX::fromJSON(Base64URL::decode(std::get<1>(parts)).toString());
-    auto a = Algorithm::none;
-    const auto algName = findAlg(h);
-    if (!algName.empty())
-        a = JWTXX::stringToAlg(algName);
-    return {a, h, c, std::get<0>(parts) + "." + std::get<1>(parts), std::get<2>(parts)};
+    if (part.size() <= maxSize)
+        return true;
+    return fail(failure, FailureDetails::tooLong(name, part.size(), maxSize));
 }
 
-JWTData parseAndValidateJWT(const std::string& token, Key key, JWTXX::Validators&& validators)
+bool decodeJSON(std::string_view part, const char* name, const JWTXX::Limits& limits, Value::Object& dest, Failure& failure)
 {
-    auto d = parseJWT(token);
+    // Typical headers and claim sets fit on the stack.
+    std::array<char, 2048> buf;
+    std::string heapBuf;
+    Base64URL::MutableSpan span(buf);
+    if (Base64URL::decodedSize(part) > buf.size())
+    {
+        heapBuf.resize(Base64URL::decodedSize(part));
+        span = Base64URL::MutableSpan(heapBuf.data(), heapBuf.size());
+    }
+    size_t size = 0;
+    if (!Base64URL::decodeInto(part, span, size))
+        return fail(failure, ErrorCode::InvalidEncoding, "Can't decode JWT " + std::string(name) + ", invalid base64url encoding.");
+    // The JSON parser reports errors with exceptions, malformed JSON in a well-formed token is rare enough.
+    try
+    {
+        dest = JWTXX::fromJSON(std::string_view(static_cast<const char*>(span.data()), size), limits.maxDepth, limits.maxMembers);
+    }
+    catch (const JWTXX::JSONLimitError& error)
+    {
+        return fail(failure, ErrorCode::LimitExceeded, "Can't decode JWT " + std::string(name) + ", " + error.what());
+    }
+    catch (const JWT::ParseError& error)
+    {
+        return fail(failure, ErrorCode::InvalidJSON, error.what());
+    }
+    return true;
+}
+
+// Sizes are checked first, before anything is decoded or allocated.
+bool parseJWT(std::string_view token, const JWTXX::Limits& limits, JWTData& d, Failure& failure)
+{
+    if (!checkSize(token, "JWT", limits.maxTokenSize, failure))
+        return false;
+    TokenParts parts;
+    if (!splitToken(token, parts))
+        return fail(failure, FailureDetails::make(ErrorCode::InvalidStructure, "JWT"));
+    if (!checkSize(parts.header, "JWT header", limits.maxSegmentSize, failure) ||
+        !checkSize(parts.claims, "JWT claims", limits.maxSegmentSize, failure) ||
+        !checkSize(parts.signature, "JWT signature", limits.maxSegmentSize, failure))
+        return false;
+    if (!decodeJSON(parts.header, "header", limits, d.header, failure) ||
+        !decodeJSON(parts.claims, "claims", limits, d.claims, failure) ||
+        !findAlg(d.header, d.alg, failure))
+        return false;
+    d.data = parts.signingInput;
+    d.signature = parts.signature;
+    return true;
+}
 
+JWTData parseJWT(std::string_view token, const JWTXX::Limits& limits)
+{
+    JWTData d{};
+    auto failure = Failure::ok();
+    if (!parseJWT(token, limits, d, failure))
+        throwFailure(failure);
+    return d;
+}
+
+bool runValidators(const Value::Object& claims, const JWTXX::ValidatorSet& validators, Failure& failure)
+{
+    auto res = validators.validate(claims);
+    if (!res)
+        return fail(failure, std::move(res));
+    return true;
+}
+
+// Either way, claims are returned only if both the signature and the validators pass.
+// Reports rejected tokens without exceptions, but lets exceptions from keys and validators through.
+bool validate(const JWTData& d, const Key& key, const JWTXX::ValidatorSet& validators, JWTXX::ValidationOrder order, Failure& failure)
+{
     if (d.alg != key.alg())
-        throw JWT::ValidationError("\"alg\" should be \"" + JWTXX::algToString(key.alg()) + "\". Actual value: \"" + JWTXX::algToString(d.alg) + "\".");
+        return fail(failure, FailureDetails::mismatch(key.alg(), d.alg));
 
-    if (!key.verify(d.data.c_str(), d.data.size(), d.signature))
-        throw JWT::ValidationError("Signature is invalid.");
-    for (const auto& validator : validators)
+    if (order == JWTXX::ValidationOrder::ClaimsFirst)
     {
-        auto res = validator(d.claims);
-        if (!res)
-            throw JWT::ValidationError(res.message());
+        // Signed tokens without a signature can't be valid, no need to compute anything.
+        if (d.alg != Algorithm::none && d.signature.empty())
+            return fail(failure, FailureDetails::make(ErrorCode::InvalidSignature, "signature"));
+        if (!runValidators(d.claims, validators, failure))
+            return false;
     }
+    if (!key.verify(d.data.data(), d.data.size(), d.signature))
+        return fail(failure, FailureDetails::make(ErrorCode::InvalidSignature, "signature"));
+    if (order == JWTXX::ValidationOrder::SignatureFirst)
+        return runValidators(d.claims, validators, failure);
+    return true;
+}
+
+bool parseAndValidate(std::string_view token, const Key& key, const JWTXX::ValidatorSet& validators, JWTXX::ValidationOrder order, const JWTXX::Limits& limits, JWTData& d, Failure& failure)
+{
+    return parseJWT(token, limits, d, failure) && validate(d, key, validators, order, failure);
+}
+
+bool findKid(const Value::Object& header, std::string& kid, Failure& failure)
+{
+    const auto it = header.find("kid");
+    if (it == header.end())
+        return true;
+    if (!it->second.isString())
+        return fail(failure, ErrorCode::UnknownKey, "\"kid\" should be a string. Actual value: \"" + it->second.toString() + "\".");
+    kid = it->second.getString();
+    return true;
+}
+
+bool unknownKey(std::string&& kid, Algorithm alg, Failure& failure) noexcept
+{
+    return fail(failure, FailureDetails::unknownKey(std::move(kid), alg));
+}
+
+bool allows(const JWTXX::KeySet& /*keys*/, Algorithm /*alg*/) noexcept { return true; }
+bool allows(const JWTXX::KeyStore& /*keys*/, Algorithm /*alg*/) noexcept { return true; }
+bool allows(const JWTXX::KeyRegistry& keys, Algorithm alg) noexcept { return keys.allows(alg); }
+
+// The header is parsed once, the key is looked up by 'kid' and 'alg' in constant time.
+template <typename Keys>
+bool parseAndValidate(std::string_view token, const Keys& keys, const JWTXX::ValidatorSet& validators, JWTXX::ValidationOrder order, const JWTXX::Limits& limits, JWTData& d, Failure& failure)
+{
+    if (!parseJWT(token, limits, d, failure))
+        return false;
+    if (!allows(keys, d.alg))
+        return fail(failure, FailureDetails::notAllowed(d.alg));
+    std::string kid;
+    if (!findKid(d.header, kid, failure))
+        return false;
+    // A pointer or a lease, which keeps the key alive until the token is verified.
+    const auto key = keys.find(kid, d.alg);
+    if (!key)
+        return unknownKey(std::move(kid), d.alg, failure);
+    return validate(d, *key, validators, order, failure);
+}
+
+template <typename Keys>
+bool tryParseAndValidate(std::string_view token, const Keys& key, const JWTXX::ValidatorSet& validators, JWTXX::ValidationOrder order, const JWTXX::Limits& limits, JWTData& d, Failure& failure) noexcept
+{
+    try
+    {
+        return parseAndValidate(token, key, validators, order, limits, d, failure);
+    }
+    catch (const Key::Error& error)
+    {
+        return fail(failure, ErrorCode::KeyError, error.what());
+    }
+    catch (const std::runtime_error& error)
+    {
+        return fail(failure, ErrorCode::ValidationFailed, error.what());
+    }
+}
 
+// Shared by the JWT::verify overloads for a key and for key collections.
+template <typename Keys>
+JWTXX::ValidationResult verifyWith(std::string_view token, const Keys& keys, const JWTXX::ValidatorSet& validators) noexcept
+{
+    JWTData d{};
+    auto failure = Failure::ok();
+    if (!tryParseAndValidate(token, keys, validators, JWTXX::ValidationOrder::SignatureFirst, JWTXX::Limits{}, d, failure))
+        return failure;
+    return JWTXX::ValidationResult::ok();
+}
+
+JWTData parseAndValidateJWT(std::string_view token, const Key& key, const JWTXX::ValidatorSet& validators, JWTXX::ValidationOrder order = JWTXX::ValidationOrder::SignatureFirst, const JWTXX::Limits& limits = JWTXX::Limits{})
+{
+    JWTData d{};
+    auto failure = Failure::ok();
+    if (!parseAndValidate(token, key, validators, order, limits, d, failure))
+        throwFailure(failure);
     return d;
 }
 
@@ -220,23 +569,49 @@ std::string JWTXX::algToString(Algorithm alg) noexcept
 
 Algorithm JWTXX::stringToAlg(const std::string& value)
 {
-    if (value == "none") return Algorithm::none;
-    if (value == "HS256") return Algorithm::HS256;
-    if (value == "HS384") return Algorithm::HS384;
-    if (value == "HS512") return Algorithm::HS512;
-    if (value == "RS256") return Algorithm::RS256;
-    if (value == "RS384") return Algorithm::RS384;
-    if (value == "RS512") return Algorithm::RS512;
-    if (value == "ES256") return Algorithm::ES256;
-    if (value == "ES384") return Algorithm::ES384;
-    if (value == "ES512") return Algorithm::ES512;
-
-    throw JWT::ParseError("Invalid algorithm name: '" + value + "'.");
+    auto res = Algorithm::none;
+    if (!algFromString(value, res))
+        throw JWT::ParseError("Invalid algorithm name: '" + value + "'.");
+    return res;
 }
 
 Key::Key(Algorithm alg, const std::string& keyData, const PasswordCallback& cb)
-    : m_alg(alg), m_impl(createKey(alg, keyData, cb))
+    : m_alg(alg), m_impl(createKey(alg, keyData, cb, {}))
+{
+}
+
+Key::Key(Algorithm alg, const std::string& keyData, const LibraryContext& context, const PasswordCallback& cb)
+    : m_alg(alg), m_impl(createKey(alg, keyData, cb, context))
+{
+}
+
+Key::Key(Algorithm alg, const std::string& keyData, Usage usage, const PasswordCallback& cb)
+    : Key(alg, keyData, LibraryContext{}, usage, cb)
+{
+}
+
+Key::Key(Algorithm alg, const std::string& keyData, const LibraryContext& context, Usage usage, const PasswordCallback& cb)
+    : m_alg(alg), m_impl(createKey(alg, keyData, cb, context)), m_usage(usage)
+{
+    if (usage == Usage::Signing)
+        m_impl->prepareSigning();
+    else
+        m_impl->prepareVerification();
+}
+
+Key::Key(Algorithm alg, Impl* impl) noexcept
+    : m_alg(alg), m_impl(impl)
+{
+}
+
+Key Key::fromMemory(Algorithm alg, std::string_view keyData, const PasswordCallback& cb)
 {
+    return fromMemory(alg, keyData, LibraryContext{}, cb);
+}
+
+Key Key::fromMemory(Algorithm alg, std::string_view keyData, const LibraryContext& context, const PasswordCallback& cb)
+{
+    return Key(alg, createKey(alg, keyData, cb, context, true));
 }
 
 Key::~Key() = default;
@@ -249,11 +624,16 @@ std::string Key::sign(const void* data, size_t size) const
 }
 
 bool Key::verify(const void* data, size_t size,
-                 const std::string& signature) const
+                 std::string_view signature) const
 {
     return m_impl->verify(data, size, signature);
 }
 
+void JWTXX::warmUp(const Key& key)
+{
+    key.m_impl->warmUp(key.m_usage);
+}
+
 std::string Key::noPasswordCallback()
 {
     throw Utils::PasswordCallbackError();
@@ -266,33 +646,119 @@ JWT::JWT(Algorithm alg, Value::Object claims, Value::Object header) noexcept
     m_header["alg"] = Value(algToString(m_alg));
 }
 
-JWT::JWT(const std::string& token, Key key, JWTXX::Validators validators)
+JWTXX::TokenView::TokenView(std::string_view token)
+{
+    TokenParts parts;
+    if (!splitToken(token, parts))
+        throwFailure(FailureDetails::make(ErrorCode::InvalidStructure, "JWT"));
+    m_header = parts.header;
+    m_claims = parts.claims;
+    m_signature = parts.signature;
+    m_signingInput = parts.signingInput;
+}
+
+JWT::JWT(std::string_view token, Key key, const JWTXX::ValidatorSet& validators)
 {
-    auto d = parseAndValidateJWT(token, std::move(key), std::move(validators));
+    auto d = parseAndValidateJWT(token, key, validators);
     m_alg = d.alg;
     m_header = std::move(d.header);
     m_claims = std::move(d.claims);
 }
 
-JWT JWT::parse(const std::string& token)
+JWT JWT::parse(std::string_view token, const JWTXX::Limits& limits)
 {
-    auto d = parseJWT(token);
+    auto d = parseJWT(token, limits);
     return JWT(d.alg, std::move(d.claims), std::move(d.header));
 }
 
-JWTXX::ValidationResult JWT::verify(const std::string& token, Key key, JWTXX::Validators validators) noexcept
+// Shared by the JWT::tryDecode overloads for a key and for key collections.
+template <typename Keys>
+JWTXX::DecodeResult JWT::decodeWith(std::string_view token, const Keys& keys, const JWTXX::ValidatorSet& validators, const JWTXX::Limits& limits) noexcept
 {
-    try
-    {
-        std::ignore = parseAndValidateJWT(token, std::move(key), std::move(validators));
-        return ValidationResult::ok();
-    }
-    catch (const std::runtime_error& error)
+    JWTData d{};
+    auto failure = Failure::ok();
+    if (!tryParseAndValidate(token, keys, validators, JWTXX::ValidationOrder::SignatureFirst, limits, d, failure))
+        return DecodeResult(std::move(failure));
+    JWT res(d.alg, std::move(d.claims));
+    res.m_header = std::move(d.header);
+    return DecodeResult(std::move(res));
+}
+
+JWTXX::ValidationResult JWT::verify(std::string_view token, Key key, const JWTXX::ValidatorSet& validators) noexcept
+{
+    return verifyWith(token, key, validators);
+}
+
+JWTXX::DecodeResult JWT::tryDecode(std::string_view token, const Key& key, const JWTXX::ValidatorSet& validators, const JWTXX::Limits& limits) noexcept
+{
+    return decodeWith(token, key, validators, limits);
+}
+
+JWTXX::ValidationResult JWT::verify(std::string_view token, const KeySet& keys, const JWTXX::ValidatorSet& validators) noexcept
+{
+    return verifyWith(token, keys, validators);
+}
+
+JWTXX::DecodeResult JWT::tryDecode(std::string_view token, const KeySet& keys, const JWTXX::ValidatorSet& validators, const JWTXX::Limits& limits) noexcept
+{
+    return decodeWith(token, keys, validators, limits);
+}
+
+JWTXX::ValidationResult JWT::verify(std::string_view token, const KeyRegistry& keys, const JWTXX::ValidatorSet& validators) noexcept
+{
+    return verifyWith(token, keys, validators);
+}
+
+JWTXX::DecodeResult JWT::tryDecode(std::string_view token, const KeyRegistry& keys, const JWTXX::ValidatorSet& validators, const JWTXX::Limits& limits) noexcept
+{
+    return decodeWith(token, keys, validators, limits);
+}
+
+JWTXX::ValidationResult JWT::verify(std::string_view token, const KeyStore& keys, const JWTXX::ValidatorSet& validators) noexcept
+{
+    return verifyWith(token, keys, validators);
+}
+
+JWTXX::DecodeResult JWT::tryDecode(std::string_view token, const KeyStore& keys, const JWTXX::ValidatorSet& validators, const JWTXX::Limits& limits) noexcept
+{
+    return decodeWith(token, keys, validators, limits);
+}
+
+std::string JWTXX::ValidationResult::message() const
+{
+    if (m_name == nullptr)
+        return m_message;
+    switch (m_code)
     {
-        return ValidationResult::failure(error.what());
+        case ErrorCode::InvalidStructure: return "JWT should have at least 2 parts separated by a dot.";
+        case ErrorCode::InvalidSignature: return "Signature is invalid.";
+        case ErrorCode::AlgorithmMismatch: return "\"alg\" should be \"" + algToString(m_expected) + "\". Actual value: \"" + algToString(m_actual) + "\".";
+        case ErrorCode::AlgorithmNotAllowed: return "Algorithm '" + algToString(m_actual) + "' is not allowed.";
+        case ErrorCode::InvalidAlgorithm: return "Invalid algorithm name: '" + m_text + "'.";
+        case ErrorCode::Expired: return "Token expired. Current time: '" + formatTime(m_bound) + "', expiration time: '" + formatTime(m_value) + "'.";
+        case ErrorCode::NotYetValid: return "Token is not valid yet. Current time: '" + formatTime(m_bound) + "', valid after: '" + formatTime(m_value) + "'.";
+        case ErrorCode::NotYetIssued: return "Token is not issued yet. Current time: '" + formatTime(m_bound) + "', issued at: '" + formatTime(m_value) + "'.";
+        case ErrorCode::InvalidClaim: return "'" + std::string(m_name) + "' claim should be '" + m_text + "'. Got: " + m_claim.toString() + ".";
+        case ErrorCode::LimitExceeded: return "Too long " + std::string(m_name) + ": " + std::to_string(m_value) + " bytes, the limit is " + std::to_string(m_bound) + ".";
+        case ErrorCode::UnknownKey: return "No key with id '" + m_text + "' for algorithm '" + algToString(m_actual) + "'.";
+        default: return m_message;
     }
 }
 
+const JWT& JWTXX::DecodeResult::jwt() const&
+{
+    if (!m_jwt)
+        throwFailure(m_result);
+    return *m_jwt;
+}
+
+JWT&& JWTXX::DecodeResult::jwt() &&
+{
+    if (!m_jwt)
+        throwFailure(m_result);
+    return std::move(*m_jwt);
+}
+
 Value JWT::claim(const std::string& name) const noexcept
 {
     auto it = m_claims.find(name);
@@ -310,23 +776,77 @@ std::string JWT::token(const Key& key) const
 {
     if (key.alg() != m_alg)
         throw Error("Token and key algorithm mismatch. Token algorithm is '" + algToString(m_alg) + "', key algorithm is '" + algToString(key.alg()) + "'.");
-    auto data = Base64URL::encode(toJSON(m_header)) + "." +
-                Base64URL::encode(toJSON(m_claims));
-    auto signature = key.sign(data.c_str(), data.size());
+    const auto header = toJSON(m_header);
+    const auto claims = toJSON(m_claims);
+    // Room for the signing input and the largest signature (RSA-4096) to avoid reallocations.
+    std::string data;
+    data.reserve(Base64URL::encodedSize(header.size()) + Base64URL::encodedSize(claims.size()) + Base64URL::encodedSize(512) + 2);
+    Base64URL::encodeAppend(data, header.data(), header.size());
+    data += '.';
+    Base64URL::encodeAppend(data, claims.data(), claims.size());
+    const auto signature = key.sign(data.c_str(), data.size());
     if (signature.empty())
         return data;
-    return data + "." + std::move(signature);
+    data += '.';
+    data += signature;
+    return data;
+}
+
+Verifier::Verifier(const Key& key)
+    : Verifier(key, ValidatorSet::defaults())
+{
+}
+
+Verifier::Verifier(const Key& key, JWTXX::ValidatorSet validators, ValidationOrder order, const JWTXX::Limits& limits)
+    // Non-owning pointer, the caller keeps the key alive.
+    : Verifier(std::shared_ptr<const Key>(std::shared_ptr<const Key>(), &key), std::move(validators), order, limits)
+{
+}
+
+Verifier::Verifier(std::shared_ptr<const Key> key)
+    : Verifier(std::move(key), ValidatorSet::defaults())
+{
+}
+
+Verifier::Verifier(std::shared_ptr<const Key> key, JWTXX::ValidatorSet validators, ValidationOrder order, const JWTXX::Limits& limits)
+    : m_key(std::move(key)), m_validators(std::move(validators)), m_order(order), m_limits(limits)
+{
+    m_key->m_impl->prepareVerification();
+}
+
+JWTXX::ValidationResult Verifier::verify(std::string_view token) const noexcept
+{
+    JWTData d{};
+    auto failure = Failure::ok();
+    if (!tryParseAndValidate(token, *m_key, m_validators, m_order, m_limits, d, failure))
+        return failure;
+    return ValidationResult::ok();
+}
+
+JWT Verifier::decode(std::string_view token) const
+{
+    auto d = parseAndValidateJWT(token, *m_key, m_validators, m_order, m_limits);
+    JWT res(d.alg, std::move(d.claims));
+    res.m_header = std::move(d.header);
+    return res;
+}
+
+JWTXX::DecodeResult Verifier::tryDecode(std::string_view token) const noexcept
+{
+    JWTData d{};
+    auto failure = Failure::ok();
+    if (!tryParseAndValidate(token, *m_key, m_validators, m_order, m_limits, d, failure))
+        return DecodeResult(std::move(failure));
+    JWT res(d.alg, std::move(d.claims));
+    res.m_header = std::move(d.header);
+    return DecodeResult(std::move(res));
 }
 
 Validator Validate::exp(std::time_t now) noexcept
 {
     return [=](const Value::Object& claims)
            {
-               return validTimeClaim(claims, "exp",
-                                     [=](std::time_t value)
-                                     {
-                                         return value > now ? ValidationResult::ok() : ValidationResult::failure("Token expired. Current time: '" + formatTime(now) + "', expiration time: '" + formatTime(value) + "'.");
-                                     });
+               return validClaim(claims, "exp", [=](const Value& value) { return checkExp(value, now); });
            };
 }
 
@@ -334,11 +854,7 @@ Validator Validate::nbf(std::time_t now) noexcept
 {
     return [=](const Value::Object& claims)
            {
-               return validTimeClaim(claims, "nbf",
-                                     [=](std::time_t value)
-                                     {
-                                         return value < now ? ValidationResult::ok() : ValidationResult::failure("Token is not valid yet. Current time: '" + formatTime(now) + "', valid after: '" + formatTime(value) + "'.");
-                                     });
+               return validClaim(claims, "nbf", [=](const Value& value) { return checkNbf(value, now); });
            };
 }
 
@@ -346,11 +862,7 @@ Validator Validate::iat(std::time_t now) noexcept
 {
     return [=](const Value::Object& claims)
            {
-               return validTimeClaim(claims, "iat",
-                                     [=](std::time_t value)
-                                     {
-                                         return value < now ? ValidationResult::ok() : ValidationResult::failure("Token is not issued yet. Current time: '" + formatTime(now) + "', issued at: '" + formatTime(value) + "'.");
-                                     });
+               return validClaim(claims, "iat", [=](const Value& value) { return checkIat(value, now); });
            };
 }
 
@@ -368,3 +880,121 @@ Validator Validate::sub(std::string subject) noexcept
 {
     return stringValidator("sub", std::move(subject));
 }
+
+std::time_t JWTXX::coarseTime() noexcept
+{
+#ifdef CLOCK_REALTIME_COARSE
+    timespec ts{};
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)
+        return ts.tv_sec;
+#endif
+    return std::time(nullptr);
+}
+
+JWTXX::ValidatorSet::ValidatorSet(std::initializer_list<Validator> validators)
+    : m_custom(validators)
+{
+}
+
+JWTXX::ValidatorSet::ValidatorSet(Validators validators) noexcept
+    : m_custom(std::move(validators))
+{
+}
+
+const JWTXX::ValidatorSet& JWTXX::ValidatorSet::defaults() noexcept
+{
+    static const ValidatorSet validators = ValidatorSet().exp();
+    return validators;
+}
+
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::exp() noexcept { return time(Exp, true, 0); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::exp(std::time_t now) noexcept { return time(Exp, false, now); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::nbf() noexcept { return time(Nbf, true, 0); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::nbf(std::time_t now) noexcept { return time(Nbf, false, now); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::iat() noexcept { return time(Iat, true, 0); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::iat(std::time_t now) noexcept { return time(Iat, false, now); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::iss(std::string issuer) noexcept { return value(Iss, std::move(issuer)); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::aud(std::string audience) noexcept { return value(Aud, std::move(audience)); }
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::sub(std::string subject) noexcept { return value(Sub, std::move(subject)); }
+
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::clock(Clock clock) noexcept
+{
+    m_clock = std::move(clock);
+    return *this;
+}
+
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::leeway(std::time_t seconds) noexcept
+{
+    m_leeway = seconds;
+    return *this;
+}
+
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::add(Validator validator)
+{
+    m_custom.push_back(std::move(validator));
+    return *this;
+}
+
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::time(Claim claim, bool currentTime, std::time_t now) noexcept
+{
+    m_checks |= 1u << claim;
+    m_times[claim] = {currentTime, now};
+    return *this;
+}
+
+JWTXX::ValidatorSet& JWTXX::ValidatorSet::value(Claim claim, std::string&& value) noexcept
+{
+    m_checks |= 1u << claim;
+    m_values[claim - Iss] = std::move(value);
+    return *this;
+}
+
+JWTXX::ValidationResult JWTXX::ValidatorSet::validate(const Value::Object& claims) const
+{
+    if (m_checks != 0)
+    {
+        // One pass over the claims, stops as soon as all checked claims are found.
+        std::array<const Value*, ClaimCount> found{};
+        auto missing = m_checks;
+        for (auto it = claims.begin(); it != claims.end() && missing != 0; ++it)
+        {
+            const auto claim = standardClaim(it->first);
+            if (claim >= 0 && (missing & (1u << claim)) != 0)
+            {
+                found[claim] = &it->second;
+                missing &= ~(1u << claim);
+            }
+        }
+
+        std::time_t current = 0;
+        if ((found[Exp] && m_times[Exp].currentTime) || (found[Nbf] && m_times[Nbf].currentTime) || (found[Iat] && m_times[Iat].currentTime))
+            current = m_clock ? m_clock() : coarseTime();
+        const auto now = [&](Claim claim) { return m_times[claim].currentTime ? current : m_times[claim].now; };
+
+        if (found[Exp])
+            if (auto res = checkExp(*found[Exp], now(Exp), m_leeway); !res)
+                return res;
+        if (found[Nbf])
+            if (auto res = checkNbf(*found[Nbf], now(Nbf), m_leeway); !res)
+                return res;
+        if (found[Iat])
+            if (auto res = checkIat(*found[Iat], now(Iat), m_leeway); !res)
+                return res;
+        if (found[Iss])
+            if (auto res = checkString("iss", *found[Iss], m_values[0]); !res)
+                return res;
+        if (found[Aud])
+            if (auto res = checkString("aud", *found[Aud], m_values[1]); !res)
+                return res;
+        if (found[Sub])
+            if (auto res = checkString("sub", *found[Sub], m_values[2]); !res)
+                return res;
+    }
+    for (const auto& validator : m_custom)
+    {
+        auto res = validator(claims);
+        if (!res)
+            return res;
+    }
+    return ValidationResult::ok();
+}
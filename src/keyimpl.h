@@ -2,7 +2,11 @@
 
 #include "jwtxx/jwt.h"
 
+#include <atomic>
 #include <string>
+#include <string_view>
+
+#include <cstdint>
 
 namespace JWTXX
 {
@@ -19,7 +23,30 @@ struct Key::Impl
     Impl& operator=(Impl&&) = default;
 
     virtual std::string sign(const void* data, size_t size) = 0;
-    virtual bool verify(const void* data, size_t size, const std::string& signature) = 0;
+    virtual bool verify(const void* data, size_t size, std::string_view signature) = 0;
+    // Loads everything verify() needs in advance, so it isn't done while verifying the first token.
+    virtual void prepareVerification() {}
+    // The same for sign().
+    virtual void prepareSigning() {}
+    // Goes through the code of the first operation: loads the key, fetches the digest, fills the context pool.
+    // Symmetric keys can always sign, so verification is warmed up with a round trip.
+    virtual void warmUp(Key::Usage usage)
+    {
+        const char data[] = "warm-up";
+        const auto signature = sign(data, sizeof(data) - 1);
+        if (usage == Key::Usage::Verification)
+            verify(data, sizeof(data) - 1, signature);
+    }
+
+    // Identifies the key in caches. Unlike the address, it is never reused by another key.
+    const uint64_t id = nextId();
+
+    private:
+        static uint64_t nextId() noexcept
+        {
+            static std::atomic<uint64_t> last{0};
+            return ++last;
+        }
 };
 
 }
@@ -0,0 +1,135 @@
+#include "jwtxx/keyregistry.h"
+
+#include "rcu.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility> // std::move, std::exchange
+
+using JWTXX::KeyRegistry;
+using JWTXX::Key;
+using JWTXX::Algorithm;
+
+namespace
+{
+
+constexpr size_t algorithms = static_cast<size_t>(Algorithm::none) + 1;
+
+struct Entry
+{
+    // Shared by the snapshots, the index refers to it.
+    std::shared_ptr<const std::string> kid;
+    std::array<std::shared_ptr<const Key>, algorithms> keys;
+};
+
+// Immutable once published. A change copies the index, keys are shared between the copies.
+using Snapshot = std::unordered_map<std::string_view, Entry>;
+
+uint32_t mask(std::initializer_list<Algorithm> algs) noexcept
+{
+    uint32_t res = 0;
+    for (const auto alg : algs)
+        res |= 1u << static_cast<unsigned>(alg);
+    return res;
+}
+
+}
+
+struct KeyRegistry::Impl
+{
+    std::mutex mutex; // Serializes changes, lookups don't use it.
+    JWTXX::RCU<Snapshot> snapshot{std::make_unique<const Snapshot>()};
+};
+
+KeyRegistry::Lease::Lease(Lease&& rhs) noexcept
+    : m_count(std::exchange(rhs.m_count, nullptr)),
+      m_key(rhs.m_key)
+{
+}
+
+KeyRegistry::Lease::~Lease()
+{
+    if (m_count != nullptr)
+        --*m_count;
+}
+
+KeyRegistry::KeyRegistry()
+    : KeyRegistry({Algorithm::HS256, Algorithm::HS384, Algorithm::HS512,
+                   Algorithm::RS256, Algorithm::RS384, Algorithm::RS512,
+                   Algorithm::ES256, Algorithm::ES384, Algorithm::ES512})
+{
+}
+
+KeyRegistry::KeyRegistry(std::initializer_list<Algorithm> algs)
+    : m_algorithms(mask(algs)),
+      m_impl(new Impl)
+{
+}
+
+KeyRegistry::~KeyRegistry() = default;
+
+void KeyRegistry::add(const std::string& kid, Key key)
+{
+    if (!allows(key.alg()))
+        throw Key::Error("Algorithm '" + algToString(key.alg()) + "' is not allowed.");
+    auto shared = std::make_shared<const Key>(std::move(key));
+
+    const std::lock_guard<std::mutex> lock(m_impl->mutex);
+    auto next = std::make_unique<Snapshot>(m_impl->snapshot.current());
+    auto it = next->find(kid);
+    if (it == next->end())
+    {
+        Entry entry;
+        entry.kid = std::make_shared<const std::string>(kid);
+        it = next->emplace(*entry.kid, std::move(entry)).first;
+    }
+    it->second.keys[static_cast<size_t>(shared->alg())] = std::move(shared);
+    m_impl->snapshot.publish(std::move(next));
+}
+
+bool KeyRegistry::remove(std::string_view kid, Algorithm alg)
+{
+    const std::lock_guard<std::mutex> lock(m_impl->mutex);
+    const auto& current = m_impl->snapshot.current();
+    const auto it = current.find(kid);
+    if (it == current.end() || !it->second.keys[static_cast<size_t>(alg)])
+        return false;
+    auto next = std::make_unique<Snapshot>(current);
+    auto& keys = next->find(kid)->second.keys;
+    keys[static_cast<size_t>(alg)].reset();
+    bool empty = true;
+    for (const auto& key : keys)
+        if (key)
+            empty = false;
+    if (empty)
+        next->erase(kid);
+    m_impl->snapshot.publish(std::move(next));
+    return true;
+}
+
+size_t KeyRegistry::size() const noexcept
+{
+    const auto snapshot = m_impl->snapshot.read();
+    size_t res = 0;
+    for (const auto& entry : *snapshot)
+        for (const auto& key : entry.second.keys)
+            if (key)
+                ++res;
+    return res;
+}
+
+KeyRegistry::Lease KeyRegistry::find(std::string_view kid, Algorithm alg) const noexcept
+{
+    if (!allows(alg))
+        return Lease(nullptr, nullptr);
+    auto snapshot = m_impl->snapshot.read();
+    const auto it = snapshot->find(kid);
+    if (it == snapshot->end() || !it->second.keys[static_cast<size_t>(alg)])
+        return Lease(nullptr, nullptr);
+    const auto* key = it->second.keys[static_cast<size_t>(alg)].get();
+    return Lease(snapshot.release(), key);
+}
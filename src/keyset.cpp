@@ -0,0 +1,311 @@
+#include "jwtxx/keyset.h"
+
+#include "json.h"
+#include "base64url.h"
+
+#include <array>
+#include <memory>
+#include <mutex> // std::once_flag, std::call_once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility> // std::move
+#include <vector>
+
+#include <openssl/crypto.h> // OPENSSL_cleanse
+
+using JWTXX::KeySet;
+using JWTXX::Key;
+using JWTXX::JWT;
+using JWTXX::Algorithm;
+using JWTXX::Value;
+
+namespace Base64URL = JWTXX::Base64URL;
+
+namespace
+{
+
+enum class KeyType { RSA, EC, Oct };
+
+// An OpenSSL key for one of the hash sizes, created on first use.
+struct Slot
+{
+    std::once_flag flag;
+    std::unique_ptr<Key> key;
+};
+
+struct Entry
+{
+    Entry() = default;
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
+    ~Entry() { OPENSSL_cleanse(&data[0], data.size()); }
+
+    std::string kid;
+    KeyType type = KeyType::RSA;
+    // From 'alg' or, for EC keys, from the curve.
+    std::optional<Algorithm> alg;
+    // SubjectPublicKeyInfo in DER for RSA and EC keys, the secret for symmetric ones.
+    std::string data;
+    // SHA-256, SHA-384 and SHA-512.
+    std::array<Slot, 3> slots;
+};
+
+// Returns -1 if the key can't be used with the algorithm.
+int slotIndex(const Entry& entry, Algorithm alg) noexcept
+{
+    if (entry.alg && *entry.alg != alg)
+        return -1;
+    switch (alg)
+    {
+        case Algorithm::none: return -1;
+        case Algorithm::HS256: return entry.type == KeyType::Oct ? 0 : -1;
+        case Algorithm::HS384: return entry.type == KeyType::Oct ? 1 : -1;
+        case Algorithm::HS512: return entry.type == KeyType::Oct ? 2 : -1;
+        case Algorithm::RS256: return entry.type == KeyType::RSA ? 0 : -1;
+        case Algorithm::RS384: return entry.type == KeyType::RSA ? 1 : -1;
+        case Algorithm::RS512: return entry.type == KeyType::RSA ? 2 : -1;
+        case Algorithm::ES256: return entry.type == KeyType::EC ? 0 : -1;
+        case Algorithm::ES384: return entry.type == KeyType::EC ? 1 : -1;
+        case Algorithm::ES512: return entry.type == KeyType::EC ? 2 : -1;
+    }
+    return -1;
+}
+
+constexpr std::array<Algorithm, 9> algorithms = {{
+    Algorithm::HS256, Algorithm::HS384, Algorithm::HS512,
+    Algorithm::RS256, Algorithm::RS384, Algorithm::RS512,
+    Algorithm::ES256, Algorithm::ES384, Algorithm::ES512
+}};
+
+// Keys with the same id are allowed (RFC 7517, 4.5) as long as a token picks one of them by its algorithm.
+const Algorithm* sharedAlgorithm(const Entry& lhs, const Entry& rhs) noexcept
+{
+    for (const auto& alg : algorithms)
+        if (slotIndex(lhs, alg) >= 0 && slotIndex(rhs, alg) >= 0)
+            return &alg;
+    return nullptr;
+}
+
+struct Curve
+{
+    std::string_view name;
+    Algorithm alg;
+    size_t size;
+    // The named curve OID in DER.
+    std::string_view oid;
+};
+
+const std::array<Curve, 3> curves = {{
+    {"P-256", Algorithm::ES256, 32, std::string_view("\x06\x08\x2A\x86\x48\xCE\x3D\x03\x01\x07", 10)},
+    {"P-384", Algorithm::ES384, 48, std::string_view("\x06\x05\x2B\x81\x04\x00\x22", 7)},
+    {"P-521", Algorithm::ES512, 66, std::string_view("\x06\x05\x2B\x81\x04\x00\x23", 7)}
+}};
+
+// AlgorithmIdentifier contents: rsaEncryption with NULL parameters and id-ecPublicKey.
+constexpr std::string_view rsaEncryption("\x06\x09\x2A\x86\x48\x86\xF7\x0D\x01\x01\x01\x05\x00", 13);
+constexpr std::string_view ecPublicKey("\x06\x07\x2A\x86\x48\xCE\x3D\x02\x01", 9);
+
+// DER element with definite length.
+std::string element(unsigned char tag, std::string_view content)
+{
+    std::string res(1, static_cast<char>(tag));
+    if (content.size() < 0x80)
+        res += static_cast<char>(content.size());
+    else
+    {
+        std::string length;
+        for (auto size = content.size(); size > 0; size >>= 8)
+            length.insert(length.begin(), static_cast<char>(size & 0xFF));
+        res += static_cast<char>(0x80 | length.size());
+        res += length;
+    }
+    res += content;
+    return res;
+}
+
+// INTEGER from an unsigned big-endian number.
+std::string integer(std::string_view value)
+{
+    while (value.size() > 1 && value[0] == 0)
+        value.remove_prefix(1);
+    std::string content;
+    if (value.empty() || (static_cast<unsigned char>(value[0]) & 0x80) != 0)
+        content += '\0';
+    content += value;
+    return element(0x02, content);
+}
+
+// SubjectPublicKeyInfo, the key itself is a BIT STRING without unused bits.
+std::string publicKeyInfo(std::string_view algorithm, std::string_view key)
+{
+    return element(0x30, element(0x30, algorithm) + element(0x03, std::string(1, '\0') + std::string(key)));
+}
+
+std::string member(const Value::Object& jwk, const std::string& name)
+{
+    const auto it = jwk.find(name);
+    if (it == jwk.end() || !it->second.isString())
+        throw Key::Error("JWK member '" + name + "' should be a string.");
+    return it->second.getString();
+}
+
+std::string decodeMember(const Value::Object& jwk, const std::string& name)
+{
+    const auto value = member(jwk, name);
+    std::string res(Base64URL::decodedSize(value), '\0');
+    size_t size = 0;
+    if (!Base64URL::decodeInto(value, Base64URL::MutableSpan(&res[0], res.size()), size))
+        throw Key::Error("JWK member '" + name + "' is not valid base64url.");
+    res.resize(size);
+    return res;
+}
+
+}
+
+struct KeySet::Impl
+{
+    std::vector<std::unique_ptr<Entry>> entries;
+    // Refers to the ids owned by the entries. Usually one entry per id, keys of different types may share it.
+    std::unordered_map<std::string_view, std::vector<Entry*>> index;
+
+    // Keys that can't be used for signatures are skipped.
+    void add(const Value::Object& jwk)
+    {
+        const auto use = jwk.find("use");
+        if (use != jwk.end() && use->second.isString() && use->second.getString() == "enc")
+            return;
+
+        auto entry = std::make_unique<Entry>();
+        if (jwk.find("kid") != jwk.end())
+            entry->kid = member(jwk, "kid");
+        if (jwk.find("alg") != jwk.end())
+        {
+            const auto alg = member(jwk, "alg");
+            try
+            {
+                entry->alg = JWTXX::stringToAlg(alg);
+            }
+            catch (const JWT::ParseError&)
+            {
+                return; // PS256, EdDSA and the like.
+            }
+            if (*entry->alg == Algorithm::none)
+                return;
+        }
+
+        const auto kty = member(jwk, "kty");
+        if (kty == "RSA")
+        {
+            entry->type = KeyType::RSA;
+            entry->data = publicKeyInfo(rsaEncryption, element(0x30, integer(decodeMember(jwk, "n")) + integer(decodeMember(jwk, "e"))));
+        }
+        else if (kty == "EC")
+        {
+            const auto crv = member(jwk, "crv");
+            const Curve* curve = nullptr;
+            for (const auto& c : curves)
+                if (c.name == crv)
+                    curve = &c;
+            if (curve == nullptr)
+                return;
+            const auto x = decodeMember(jwk, "x");
+            const auto y = decodeMember(jwk, "y");
+            if (x.size() != curve->size || y.size() != curve->size)
+                throw Key::Error("JWK coordinates don't match curve '" + crv + "'.");
+            if (entry->alg && *entry->alg != curve->alg)
+                throw Key::Error("JWK algorithm '" + JWTXX::algToString(*entry->alg) + "' doesn't match curve '" + crv + "'.");
+            entry->type = KeyType::EC;
+            entry->alg = curve->alg;
+            // Uncompressed point.
+            entry->data = publicKeyInfo(std::string(ecPublicKey) + std::string(curve->oid), "\x04" + x + y);
+        }
+        else if (kty == "oct")
+        {
+            entry->type = KeyType::Oct;
+            entry->data = decodeMember(jwk, "k");
+        }
+        else
+            return;
+
+        if (entry->alg && slotIndex(*entry, *entry->alg) < 0)
+            throw Key::Error("JWK algorithm '" + JWTXX::algToString(*entry->alg) + "' doesn't match key type '" + kty + "'.");
+
+        auto& sameId = index[entry->kid];
+        for (const auto* other : sameId)
+            if (const auto* alg = sharedAlgorithm(*other, *entry))
+                throw Key::Error("Duplicate key id '" + entry->kid + "' for algorithm '" + JWTXX::algToString(*alg) + "'.");
+        entries.push_back(std::move(entry));
+        sameId.push_back(entries.back().get());
+    }
+};
+
+KeySet::KeySet(std::string_view jwks)
+    : m_impl(new Impl)
+{
+    Value::Object document;
+    try
+    {
+        document = fromJSON(jwks);
+    }
+    catch (const JWT::ParseError& error)
+    {
+        throw Key::Error("Can't parse JWKS. " + std::string(error.what()));
+    }
+    const auto keys = document.find("keys");
+    if (keys == document.end())
+    {
+        m_impl->add(document);
+        return;
+    }
+    if (!keys->second.isArray())
+        throw Key::Error("JWKS member 'keys' should be an array.");
+    for (const auto& jwk : keys->second.getArray())
+    {
+        if (!jwk.isObject())
+            throw Key::Error("JWKS keys should be objects.");
+        m_impl->add(jwk.getObject());
+    }
+}
+
+KeySet::~KeySet() = default;
+KeySet::KeySet(KeySet&&) noexcept = default;
+KeySet& KeySet::operator=(KeySet&&) noexcept = default;
+
+size_t KeySet::size() const noexcept
+{
+    return m_impl->entries.size();
+}
+
+bool KeySet::contains(std::string_view kid) const noexcept
+{
+    return m_impl->index.count(kid) != 0;
+}
+
+const Key* KeySet::find(std::string_view kid, Algorithm alg) const
+{
+    const auto it = m_impl->index.find(kid);
+    if (it == m_impl->index.end())
+        return nullptr;
+    // At most one of the keys with the id can be used with the algorithm.
+    for (auto* entry : it->second)
+    {
+        const auto index = slotIndex(*entry, alg);
+        if (index < 0)
+            continue;
+        auto& slot = entry->slots[static_cast<size_t>(index)];
+        // A failure is not remembered, the next call tries again.
+        std::call_once(slot.flag, [&]{ slot.key = std::make_unique<Key>(Key::fromMemory(alg, entry->data)); });
+        return slot.key.get();
+    }
+    return nullptr;
+}
+
+void JWTXX::warmUp(const KeySet& keys)
+{
+    for (const auto& entry : keys.m_impl->entries)
+        for (const auto alg : algorithms)
+            if (slotIndex(*entry, alg) >= 0)
+                warmUp(*keys.find(entry->kid, alg));
+}
@@ -0,0 +1,331 @@
+#include "jwtxx/keystore.h"
+#include "jwtxx/keyset.h"
+
+#include "rcu.h"
+#include "utils.h"
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility> // std::move
+#include <vector>
+
+#include <cerrno>
+#include <cstring> // strerror
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <openssl/crypto.h> // OPENSSL_cleanse
+
+using JWTXX::KeyStore;
+using JWTXX::KeyFile;
+using JWTXX::KeySet;
+using JWTXX::Key;
+using JWTXX::Algorithm;
+
+namespace Utils = JWTXX::Utils;
+
+namespace
+{
+
+constexpr size_t algorithms = static_cast<size_t>(Algorithm::none) + 1;
+
+// Keys of one generation, either from a JWKS file or from key files.
+struct Snapshot
+{
+    std::unique_ptr<const KeySet> set;
+    // Refers to the ids of the store's KeyFiles.
+    std::unordered_map<std::string_view, std::array<std::unique_ptr<const Key>, algorithms>> keys;
+};
+
+std::string directory(const std::string& fileName)
+{
+    const auto pos = fileName.rfind('/');
+    if (pos == std::string::npos)
+        return ".";
+    if (pos == 0)
+        return "/";
+    return fileName.substr(0, pos);
+}
+
+bool isAsymmetric(Algorithm alg) noexcept
+{
+    return alg != Algorithm::none && alg != Algorithm::HS256 && alg != Algorithm::HS384 && alg != Algorithm::HS512;
+}
+
+std::string baseName(const std::string& fileName)
+{
+    const auto pos = fileName.rfind('/');
+    return pos == std::string::npos ? fileName : fileName.substr(pos + 1);
+}
+
+}
+
+struct KeyStore::Impl
+{
+    Impl(std::vector<KeyFile> keyFiles, std::string jwks, ErrorCallback cb)
+        : files(std::move(keyFiles)),
+          jwksFile(std::move(jwks)),
+          onError(std::move(cb)),
+          snapshot(std::make_unique<const Snapshot>())
+    {
+        try
+        {
+            // The files are watched before they are read, so a rotation during the first load is not missed.
+            watch();
+            snapshot.publish(load());
+            start();
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+    }
+
+    ~Impl() { stop(); }
+
+    Impl(const Impl&) = delete;
+    Impl& operator=(const Impl&) = delete;
+
+    const std::vector<KeyFile> files;
+    const std::string jwksFile;
+    const ErrorCallback onError;
+
+    std::mutex mutex; // One reload at a time.
+    JWTXX::RCU<Snapshot> snapshot;
+    std::atomic<size_t> generation{1};
+
+    int notify = -1;
+    int wake = -1;
+    std::unordered_set<std::string> names; // Of the watched files.
+    std::thread watcher;
+
+    // Keys are loaded and warmed up here, so the first verification with them is as fast as the others.
+    std::unique_ptr<const Snapshot> load() const
+    {
+        auto res = std::make_unique<Snapshot>();
+        if (!jwksFile.empty())
+        {
+            auto data = Utils::readKeyFile(jwksFile);
+            try
+            {
+                auto set = std::make_unique<const KeySet>(data);
+                warmUp(*set);
+                res->set = std::move(set);
+            }
+            catch (...)
+            {
+                OPENSSL_cleanse(&data[0], data.size());
+                throw;
+            }
+            OPENSSL_cleanse(&data[0], data.size());
+        }
+        for (const auto& file : files)
+        {
+            if (!isAsymmetric(file.alg))
+                throw Key::Error("Key file '" + file.fileName + "' can't be used with algorithm '" + algToString(file.alg) + "', use a JWKS file for symmetric keys.");
+            auto& slot = res->keys[file.kid][static_cast<size_t>(file.alg)];
+            if (slot)
+                throw Key::Error("Duplicate key id '" + file.kid + "' for algorithm '" + algToString(file.alg) + "'.");
+            auto key = std::make_unique<const Key>(file.alg, file.fileName, Key::Usage::Verification);
+            warmUp(*key);
+            slot = std::move(key);
+        }
+        return res;
+    }
+
+    void reload()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        // Readers keep using the old keys meanwhile.
+        snapshot.publish(load());
+        ++generation;
+    }
+
+#ifdef __linux__
+    // Directories are watched rather than files: keys are usually replaced by renaming a new file over the old one.
+    void watch()
+    {
+        notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notify == -1)
+            throw Key::Error("Can't watch key files. " + std::string(strerror(errno)));
+        wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake == -1)
+            throw Key::Error("Can't watch key files. " + std::string(strerror(errno)));
+
+        std::unordered_set<std::string> dirs;
+        auto add = [&](const std::string& fileName)
+                   {
+                       dirs.insert(directory(fileName));
+                       names.insert(baseName(fileName));
+                   };
+        if (!jwksFile.empty())
+            add(jwksFile);
+        for (const auto& file : files)
+            add(file.fileName);
+        for (const auto& dir : dirs)
+            if (inotify_add_watch(notify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB) == -1)
+                throw Key::Error("Can't watch key directory '" + dir + "'. " + std::string(strerror(errno)));
+    }
+
+    // Events that came during the first load are handled as usual.
+    void start()
+    {
+        watcher = std::thread([this] { run(); });
+    }
+
+    void run() noexcept
+    {
+        // Files are often written in several steps, a reload waits until they settle.
+        constexpr int settleTime = 100; // ms
+        std::array<pollfd, 2> fds{{{notify, POLLIN, 0}, {wake, POLLIN, 0}}};
+        bool pending = false;
+        for (;;)
+        {
+            const auto ready = poll(fds.data(), fds.size(), pending ? settleTime : -1);
+            if (ready == -1)
+            {
+                if (errno == EINTR)
+                    continue;
+                report("Can't watch key files. " + std::string(strerror(errno)));
+                return;
+            }
+            if (fds[1].revents != 0)
+                return;
+            if (ready == 0)
+            {
+                pending = false;
+                tryReload();
+                continue;
+            }
+            if (drain())
+                pending = true;
+        }
+    }
+
+    // Reads the pending events, returns true if any of them concerns the keys.
+    bool drain() noexcept
+    {
+        bool res = false;
+        alignas(inotify_event) std::array<char, 4096> buf;
+        for (;;)
+        {
+            const auto size = ::read(notify, buf.data(), buf.size());
+            if (size <= 0)
+                return res;
+            for (ssize_t pos = 0; pos < size;)
+            {
+                inotify_event event;
+                std::memcpy(&event, buf.data() + pos, sizeof(event));
+                const std::string name = event.len > 0 ? std::string(buf.data() + pos + sizeof(event)) : std::string();
+                // Kubernetes swaps a '..data' symlink to update mounted secrets.
+                if (names.count(name) != 0 || name.compare(0, 2, "..") == 0 || (event.mask & IN_Q_OVERFLOW) != 0)
+                    res = true;
+                pos += static_cast<ssize_t>(sizeof(event) + event.len);
+            }
+        }
+    }
+
+    void stop() noexcept
+    {
+        if (watcher.joinable())
+        {
+            const uint64_t one = 1;
+            // Can't fail, the counter is far from overflow.
+            static_cast<void>(::write(wake, &one, sizeof(one)));
+            watcher.join();
+        }
+        if (wake != -1)
+            ::close(wake);
+        if (notify != -1)
+            ::close(notify);
+    }
+#else
+    void watch() noexcept {}
+    void start() noexcept {}
+    void stop() noexcept {}
+#endif
+
+    void tryReload() noexcept
+    {
+        try
+        {
+            reload();
+        }
+        catch (const std::exception& error)
+        {
+            report(error.what());
+        }
+    }
+
+    void report(const std::string& message) const noexcept
+    {
+        if (!onError)
+            return;
+        try
+        {
+            onError(message);
+        }
+        catch (...)
+        {
+        }
+    }
+};
+
+KeyStore::KeyStore(std::vector<KeyFile> files, ErrorCallback onError)
+    : m_impl(new Impl(std::move(files), {}, std::move(onError)))
+{
+}
+
+KeyStore::KeyStore(const std::string& jwksFile, ErrorCallback onError)
+    : m_impl(new Impl({}, jwksFile, std::move(onError)))
+{
+}
+
+KeyStore::~KeyStore() = default;
+
+void KeyStore::reload()
+{
+    m_impl->reload();
+}
+
+size_t KeyStore::generation() const noexcept
+{
+    return m_impl->generation;
+}
+
+KeyStore::Lease KeyStore::find(std::string_view kid, Algorithm alg) const noexcept
+{
+    auto snapshot = m_impl->snapshot.read();
+    const Key* key = nullptr;
+    const auto it = snapshot->keys.find(kid);
+    if (it != snapshot->keys.end())
+        key = it->second[static_cast<size_t>(alg)].get();
+    else if (snapshot->set)
+    {
+        // All keys of the set were created by warmUp, so find() doesn't create anything.
+        try
+        {
+            key = snapshot->set->find(kid, alg);
+        }
+        catch (const Key::Error&)
+        {
+        }
+    }
+    if (key == nullptr)
+        return Lease(nullptr, nullptr);
+    return Lease(snapshot.release(), key);
+}
@@ -10,7 +10,7 @@ namespace Keys
 struct None : public Key::Impl
 {
     std::string sign(const void* /*data*/, size_t /*size*/) override { return {}; }
-    bool verify(const void* /*data*/, size_t /*size*/, const std::string& /*signature*/) override { return true; }
+    bool verify(const void* /*data*/, size_t /*size*/, std::string_view /*signature*/) override { return true; }
 };
 
 }
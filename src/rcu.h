@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility> // std::exchange
+
+#include <cstddef>
+
+namespace JWTXX
+{
+
+// Publishes immutable values to readers that never lock, read-copy-update style.
+// A reader registers in the current epoch before it loads the value. A writer swaps the value,
+// starts a new epoch and deletes the old value once the readers of the previous epoch are gone.
+// Writers must be serialized by the caller and must not hold a Reader on the same thread.
+template <typename T>
+class RCU
+{
+    public:
+        class Reader
+        {
+            public:
+                Reader(Reader&& rhs) noexcept : m_count(std::exchange(rhs.m_count, nullptr)), m_value(rhs.m_value) {}
+                ~Reader() { if (m_count != nullptr) m_count->fetch_sub(1); }
+
+                Reader(const Reader&) = delete;
+                Reader& operator=(const Reader&) = delete;
+                Reader& operator=(Reader&&) = delete;
+
+                const T& operator*() const noexcept { return *m_value; }
+                const T* operator->() const noexcept { return m_value; }
+
+                // Hands the registration over to the caller, who has to decrement the counter when done.
+                std::atomic<size_t>* release() noexcept { return std::exchange(m_count, nullptr); }
+
+            private:
+                friend class RCU;
+
+                std::atomic<size_t>* m_count;
+                const T* m_value;
+
+                Reader(std::atomic<size_t>* count, const T* value) noexcept : m_count(count), m_value(value) {}
+        };
+
+        explicit RCU(std::unique_ptr<const T> value) noexcept : m_value(value.release()) {}
+        ~RCU() { delete m_value.load(); }
+
+        RCU(const RCU&) = delete;
+        RCU& operator=(const RCU&) = delete;
+
+        Reader read() const noexcept
+        {
+            auto& stripe = m_stripes[stripeIndex()];
+            for (;;)
+            {
+                const auto epoch = m_epoch.load();
+                auto& count = stripe.counts[epoch & 1];
+                ++count;
+                // A writer may have moved on between the two loads, then it won't wait for this reader.
+                if (m_epoch.load() == epoch)
+                    return Reader(&count, m_value.load());
+                --count;
+            }
+        }
+
+        // For writers, the value can't change under them.
+        const T& current() const noexcept { return *m_value.load(); }
+
+        void publish(std::unique_ptr<const T> value) noexcept
+        {
+            const std::unique_ptr<const T> old(m_value.exchange(value.release()));
+            const auto epoch = m_epoch.fetch_add(1);
+            for (auto& stripe : m_stripes)
+                while (stripe.counts[epoch & 1].load() != 0)
+                    std::this_thread::yield();
+        }
+
+    private:
+        static constexpr size_t stripes = 16;
+
+        // Readers are spread over cache lines, so they don't contend for a single counter.
+        struct alignas(64) Stripe
+        {
+            std::array<std::atomic<size_t>, 2> counts{};
+        };
+
+        std::atomic<const T*> m_value;
+        std::atomic<size_t> m_epoch{0};
+        mutable std::array<Stripe, stripes> m_stripes;
+
+        static size_t stripeIndex() noexcept
+        {
+            static std::atomic<size_t> next{0};
+            thread_local const size_t index = next++ % stripes;
+            return index;
+        }
+};
+
+}
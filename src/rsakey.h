@@ -4,7 +4,10 @@
 #include "asymmetric.h"
 #include "base64url.h"
 
+#include <array>
+
 #include <openssl/evp.h>
+#include <openssl/rsa.h> // OPENSSL_RSA_MAX_MODULUS_BITS
 
 namespace JWTXX
 {
@@ -14,8 +17,12 @@ namespace Keys
 class RSA : public Key::Impl
 {
     public:
-        RSA(const EVP_MD* digest, const std::string& keyData, const Key::PasswordCallback& cb)
-            : m_key(Asymmetric::Type::RSA, digest, keyData, cb)
+        RSA(const char* digest, const std::string& keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context)
+            : m_key(Asymmetric::Type::RSA, digest, keyData, cb, context)
+        {
+        }
+        RSA(const char* digest, std::string_view keyData, const Key::PasswordCallback& cb, const Key::LibraryContext& context, Asymmetric::InMemory tag)
+            : m_key(Asymmetric::Type::RSA, digest, keyData, cb, context, tag)
         {
         }
 
@@ -23,12 +30,35 @@ class RSA : public Key::Impl
         {
             return Base64URL::encode(m_key.sign(data, size));
         }
-        bool verify(const void* data, size_t size, const std::string& signature) override
+        bool verify(const void* data, size_t size, std::string_view signature) override
         {
-            return m_key.verify(data, size, Base64URL::decode(signature));
+            std::array<unsigned char, maxSignatureSize> sig;
+            size_t sigSize = 0;
+            if (!Base64URL::decodeInto(signature, sig, sigSize))
+                return false;
+            return m_key.verify(data, size, sig.data(), sigSize);
+        }
+
+        void prepareVerification() override
+        {
+            m_key.getPubKey();
+        }
+        void prepareSigning() override
+        {
+            m_key.getPrivKey();
+        }
+        void warmUp(Key::Usage usage) override
+        {
+            if (usage == Key::Usage::Signing)
+                Impl::warmUp(usage);
+            else
+                m_key.warmUpVerification();
         }
 
     private:
+        // RSA signature is as long as the modulus, OpenSSL won't load keys larger than this.
+        static constexpr size_t maxSignatureSize = OPENSSL_RSA_MAX_MODULUS_BITS / 8;
+
         Asymmetric m_key;
 };
 
@@ -6,17 +6,22 @@
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 #include <openssl/err.h>
+#include <openssl/crypto.h> // OPENSSL_cleanse
 #include <openssl/opensslv.h> // OPENSSL_VERSION_NUMBER
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
 #include <openssl/core_names.h> // OSSL_PKEY_PARAM_GROUP_NAME
 #endif
 
 #include <array>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <functional> // std::function
+#include <initializer_list>
 #include <algorithm> // std::min
 #include <utility> // std::move
 #include <exception>
+#include <tuple> // std::ignore
 
 #include <cstring> // strerror
 #include <cstdio> // fopen, fclose
@@ -46,42 +51,197 @@ struct X509Deleter
 };
 using X509Ptr = std::unique_ptr<X509, X509Deleter>;
 
+std::vector<Utils::EVPMDCTXPtr>& mdCtxPool() noexcept
+{
+    thread_local std::vector<Utils::EVPMDCTXPtr> pool;
+    return pool;
+}
+
 std::string sysError() noexcept
 {
     return strerror(errno);
 }
 
-Utils::EVPKeyPtr readPublicKey(const std::string& src)
+struct BIODeleter
 {
-    // src is file name
-    const FilePtr fp(fopen(src.c_str(), "rbe"));
-    if (fp)
-        return Utils::EVPKeyPtr(PEM_read_PUBKEY(fp.get(), nullptr, nullptr, nullptr));
+    void operator()(BIO* bio) const noexcept { BIO_free(bio); }
+};
+using BIOPtr = std::unique_ptr<BIO, BIODeleter>;
 
-    // src is key data
+BIOPtr memoryBIO(std::string_view data)
+{
 #ifdef CONST_BIO_NEW_MEM_BUF
     // Starting from the OpenSSL 1.0.2 the first parameter of the BIO_new_mem_buf is constant.
-    BIO* bio = BIO_new_mem_buf(src.data(), static_cast<int>(src.size()));
+    BIOPtr bio(BIO_new_mem_buf(data.data(), static_cast<int>(data.size())));
 #else
     // Before the OpenSSL 1.0.2 the first parameter of the BIO_new_mem_buf is not constant.
-    BIO* bio = BIO_new_mem_buf(const_cast<char*>(src.data()), static_cast<int>(src.size()));
+    BIOPtr bio(BIO_new_mem_buf(const_cast<char*>(data.data()), static_cast<int>(data.size())));
 #endif
-    Utils::EVPKeyPtr key(PEM_read_bio_PUBKEY(bio, nullptr, nullptr, nullptr));
-
-    BIO_free(bio);
-
-    return key;
+    if (!bio)
+        throw JWTXX::Key::Error("Can't create memory buffer. " + Utils::OPENSSLError());
+    return bio;
 }
 
-Utils::EVPKeyPtr readCert(const std::string& fileName)
+// Wipes key data read from a file, the buffer is freed with the private key in it otherwise.
+struct Cleanser
+{
+    explicit Cleanser(std::string& data) noexcept : buffer(data) {}
+    ~Cleanser() { OPENSSL_cleanse(&buffer[0], buffer.size()); }
+    Cleanser(const Cleanser&) = delete;
+    Cleanser& operator=(const Cleanser&) = delete;
+    std::string& buffer;
+};
+
+// Reads the whole file with a single read, returns false if it can't be opened.
+bool readFile(const std::string& fileName, std::string& dest)
 {
     const FilePtr fp(fopen(fileName.c_str(), "rbe"));
     if (!fp)
-        throw JWTXX::Key::Error("Can't open key file '" + fileName + "'. " + sysError());
-    const X509Ptr cert(PEM_read_X509(fp.get(), nullptr, nullptr, nullptr));
-    if (!cert)
+        return false;
+    if (fseek(fp.get(), 0, SEEK_END) != 0)
+        throw JWTXX::Key::Error("Can't read key file '" + fileName + "'. " + sysError());
+    const auto size = ftell(fp.get());
+    if (size < 0 || fseek(fp.get(), 0, SEEK_SET) != 0)
+        throw JWTXX::Key::Error("Can't read key file '" + fileName + "'. " + sysError());
+    dest.resize(static_cast<size_t>(size));
+    if (fread(&dest[0], 1, dest.size(), fp.get()) != dest.size())
+        throw JWTXX::Key::Error("Can't read key file '" + fileName + "'. " + sysError());
+    return true;
+}
+
+enum class KeyKind { Unknown, Private, EncryptedPrivate, Public, Certificate };
+
+const char* kindName(KeyKind kind) noexcept
+{
+    switch (kind)
+    {
+        case KeyKind::Unknown: return "key";
+        case KeyKind::Private: return "private key";
+        case KeyKind::EncryptedPrivate: return "private key";
+        case KeyKind::Public: return "public key";
+        case KeyKind::Certificate: return "certificate";
+    }
+    return "key";
+}
+
+// DER always starts with a SEQUENCE, PEM starts with text.
+bool isDER(std::string_view data) noexcept
+{
+    return !data.empty() && data[0] == 0x30;
+}
+
+KeyKind pemKind(std::string_view label) noexcept
+{
+    if (label == "PRIVATE KEY" || label == "ENCRYPTED PRIVATE KEY" || label == "RSA PRIVATE KEY" || label == "EC PRIVATE KEY")
+        return KeyKind::Private; // PEM readers decrypt any of them.
+    if (label == "PUBLIC KEY")
+        return KeyKind::Public;
+    if (label == "CERTIFICATE" || label == "TRUSTED CERTIFICATE" || label == "X509 CERTIFICATE")
+        return KeyKind::Certificate;
+    return KeyKind::Unknown;
+}
+
+// Finds the next complete PEM block starting from 'pos', moves 'pos' past it.
+bool nextPEMBlock(std::string_view data, size_t& pos, std::string_view& label, std::string_view& block) noexcept
+{
+    constexpr std::string_view begin = "-----BEGIN ";
+    constexpr std::string_view dashes = "-----";
+    const auto start = data.find(begin, pos);
+    if (start == std::string_view::npos)
+        return false;
+    const auto labelStart = start + begin.size();
+    const auto labelEnd = data.find(dashes, labelStart);
+    if (labelEnd == std::string_view::npos)
+        return false;
+    label = data.substr(labelStart, labelEnd - labelStart);
+    const auto end = data.find("-----END " + std::string(label) + std::string(dashes), labelEnd + dashes.size());
+    if (end == std::string_view::npos)
+        return false;
+    pos = end + std::string_view("-----END ").size() + label.size() + dashes.size();
+    block = data.substr(start, pos - start);
+    return true;
+}
+
+// Reads a DER tag and length, leaves 'pos' at the content.
+bool derHeader(std::string_view data, size_t& pos, unsigned char& tag, size_t& length) noexcept
+{
+    if (data.size() - pos < 2)
+        return false;
+    tag = static_cast<unsigned char>(data[pos++]);
+    const auto first = static_cast<unsigned char>(data[pos++]);
+    length = first;
+    if (first > 0x7F)
+    {
+        const size_t count = first & 0x7FU;
+        if (count == 0 || count > sizeof(size_t) || data.size() - pos < count)
+            return false;
+        length = 0;
+        for (size_t i = 0; i < count; ++i)
+            length = (length << 8) | static_cast<unsigned char>(data[pos++]);
+    }
+    return length <= data.size() - pos;
+}
+
+// Only the outer structure is looked at:
+// PrivateKeyInfo (PKCS#8) and traditional RSA and EC keys start with a version INTEGER;
+// SubjectPublicKeyInfo, EncryptedPrivateKeyInfo and Certificate start with a SEQUENCE
+// and are told apart by the element after it: BIT STRING, OCTET STRING and SEQUENCE respectively.
+KeyKind derKind(std::string_view data) noexcept
+{
+    constexpr unsigned char integer = 0x02;
+    constexpr unsigned char bitString = 0x03;
+    constexpr unsigned char octetString = 0x04;
+    constexpr unsigned char sequence = 0x30;
+    size_t pos = 0;
+    unsigned char tag = 0;
+    size_t length = 0;
+    if (!derHeader(data, pos, tag, length) || tag != sequence || !derHeader(data, pos, tag, length))
+        return KeyKind::Unknown;
+    if (tag == integer)
+        return KeyKind::Private;
+    if (tag != sequence)
+        return KeyKind::Unknown;
+    pos += length;
+    if (!derHeader(data, pos, tag, length))
+        return KeyKind::Unknown;
+    switch (tag)
+    {
+        case bitString: return KeyKind::Public;
+        case octetString: return KeyKind::EncryptedPrivate;
+        case sequence: return KeyKind::Certificate;
+    }
+    return KeyKind::Unknown;
+}
+
+// A PEM block or a whole DER structure.
+struct KeyBlock
+{
+    KeyKind kind = KeyKind::Unknown;
+    std::string_view data;
+};
+
+// Returns the first block of the first wanted kind that is present.
+// PEM files may bundle several blocks, e.g. a key and its certificate; the others are skipped, like OpenSSL PEM readers do.
+KeyBlock findBlock(std::string_view data, std::initializer_list<KeyKind> wanted) noexcept
+{
+    if (isDER(data))
+    {
+        const auto kind = derKind(data);
+        for (const auto w : wanted)
+            if (kind == w)
+                return {kind, data};
         return {};
-    return Utils::EVPKeyPtr(X509_get_pubkey(cert.get()));
+    }
+    for (const auto w : wanted)
+    {
+        size_t pos = 0;
+        std::string_view label;
+        std::string_view block;
+        while (nextPEMBlock(data, pos, label, block))
+            if (pemKind(label) == w)
+                return {w, block};
+    }
+    return {};
 }
 
 int passwordCallback(char* buf, int size, int /*rwflag*/, void* data)
@@ -103,24 +263,104 @@ int passwordCallback(char* buf, int size, int /*rwflag*/, void* data)
     }
 }
 
+Utils::EVPKeyPtr readCertificate(std::string_view data, const JWTXX::Key::LibraryContext& context)
+{
+    const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    X509Ptr cert(X509_new_ex(context.libCtx, Utils::propertyQuery(context)));
+    if (!cert)
+        return {};
+    auto* certPtr = cert.get();
+    const auto* res = isDER(data) ? d2i_X509(&certPtr, &p, static_cast<long>(data.size()))
+                                  : PEM_read_bio_X509(memoryBIO(data).get(), &certPtr, nullptr, nullptr);
+    if (res == nullptr)
+    {
+        // The object is freed if it was decoded and turned out to be broken, but not if there was nothing to decode.
+        if (certPtr == nullptr)
+            std::ignore = cert.release();
+        return {};
+    }
+#else
+    static_cast<void>(context);
+    const X509Ptr cert(isDER(data) ? d2i_X509(nullptr, &p, static_cast<long>(data.size()))
+                                   : PEM_read_bio_X509(memoryBIO(data).get(), nullptr, nullptr, nullptr));
+    if (!cert)
+        return {};
+#endif
+    return Utils::EVPKeyPtr(X509_get_pubkey(cert.get()));
+}
+
+// Returns nullptr if OpenSSL can't read the key.
+Utils::EVPKeyPtr readKey(std::string_view data, KeyKind kind, const JWTXX::Key::PasswordCallback& cb, const JWTXX::Key::LibraryContext& context)
+{
+    const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+    const auto size = static_cast<long>(data.size());
+    const auto der = isDER(data);
+    switch (kind)
+    {
+        case KeyKind::Unknown:
+            return {};
+        case KeyKind::Private:
+        case KeyKind::EncryptedPrivate:
+        {
+            PasswordCallbackTester tester(cb);
+            Utils::EVPKeyPtr key;
+            if (kind == KeyKind::EncryptedPrivate)
+                key.reset(d2i_PKCS8PrivateKey_bio(memoryBIO(data).get(), nullptr, passwordCallback, &tester));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            else if (der)
+                key.reset(d2i_AutoPrivateKey_ex(nullptr, &p, size, context.libCtx, Utils::propertyQuery(context)));
+            else
+                key.reset(PEM_read_bio_PrivateKey_ex(memoryBIO(data).get(), nullptr, passwordCallback, &tester, context.libCtx, Utils::propertyQuery(context)));
+#else
+            else if (der)
+                key.reset(d2i_AutoPrivateKey(nullptr, &p, size));
+            else
+                key.reset(PEM_read_bio_PrivateKey(memoryBIO(data).get(), nullptr, passwordCallback, &tester));
+#endif
+            if (tester.exception)
+                std::rethrow_exception(tester.exception);
+            return key;
+        }
+        case KeyKind::Public:
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+            if (der)
+                return Utils::EVPKeyPtr(d2i_PUBKEY_ex(nullptr, &p, size, context.libCtx, Utils::propertyQuery(context)));
+            return Utils::EVPKeyPtr(PEM_read_bio_PUBKEY_ex(memoryBIO(data).get(), nullptr, nullptr, nullptr, context.libCtx, Utils::propertyQuery(context)));
+#else
+            if (der)
+                return Utils::EVPKeyPtr(d2i_PUBKEY(nullptr, &p, size));
+            return Utils::EVPKeyPtr(PEM_read_bio_PUBKEY(memoryBIO(data).get(), nullptr, nullptr, nullptr));
+#endif
+        case KeyKind::Certificate:
+            return readCertificate(data, context);
+    }
+    return {};
+}
+
+Utils::EVPKeyPtr checkKey(Utils::EVPKeyPtr key, const std::string& what, const char* type)
+{
+    if (!key)
+        throw JWTXX::Key::Error("Can't read " + what + ". " + Utils::OPENSSLError());
+    if (EVP_PKEY_is_a(key.get(), type) == 0)
+        throw JWTXX::Key::Error("Expected " + std::string(type) + " key, got " + std::string(EVP_PKEY_get0_type_name(key.get())));
+    return key;
+}
+
 }
 
-Utils::EVPKeyPtr Utils::readPEMPrivateKey(const std::string& fileName, const JWTXX::Key::PasswordCallback& cb, const char* type)
+Utils::EVPKeyPtr Utils::readPrivateKey(const std::string& fileName, const JWTXX::Key::PasswordCallback& cb, const char* type, const Key::LibraryContext& context)
 {
-    const FilePtr fp(fopen(fileName.c_str(), "rbe"));
-    if (!fp)
+    std::string data;
+    const Cleanser cleanser(data);
+    if (!readFile(fileName, data))
         throw Key::Error("Can't open key file '" + fileName + "'. " + sysError());
+    const auto block = findBlock(data, {KeyKind::Private, KeyKind::EncryptedPrivate});
+    if (block.kind == KeyKind::Unknown)
+        throw Key::Error("Can't read private key '" + fileName + "'. The file contains no private key.");
     try
     {
-        PasswordCallbackTester tester(cb);
-        EVPKeyPtr key(PEM_read_PrivateKey(fp.get(), nullptr, passwordCallback, &tester));
-        if (tester.exception)
-            std::rethrow_exception(tester.exception);
-        if (!key)
-            throw Key::Error("Can't read private key '" + fileName + "'. " + OPENSSLError());
-        if (EVP_PKEY_is_a(key.get(), type) == 0)
-            throw Key::Error("Expected " + std::string(type) + " key, got " + std::string(EVP_PKEY_get0_type_name(key.get())));
-        return key;
+        return checkKey(readKey(block.data, block.kind, cb, context), "private key '" + fileName + "'", type);
     }
     catch (const PasswordCallbackError&)
     {
@@ -128,20 +368,82 @@ Utils::EVPKeyPtr Utils::readPEMPrivateKey(const std::string& fileName, const JWT
     }
 }
 
-Utils::EVPKeyPtr Utils::readPEMPublicKey(const std::string& fileName, const char* type)
+Utils::EVPKeyPtr Utils::readPublicKey(const std::string& src, const char* type, const Key::LibraryContext& context)
 {
-    auto key = readPublicKey(fileName);
-    std::string pkError;
-    if (!key)
+    // src is either a file name or key data.
+    std::string contents;
+    const auto fromFile = readFile(src, contents);
+    const auto openError = fromFile ? std::string() : sysError();
+    const std::string_view data = fromFile ? std::string_view(contents) : std::string_view(src);
+    const auto block = findBlock(data, {KeyKind::Public, KeyKind::Certificate});
+    if (block.kind == KeyKind::Unknown)
     {
-        pkError = OPENSSLError();
-        key = readCert(fileName);
+        if (!fromFile && findBlock(data, {KeyKind::Private, KeyKind::EncryptedPrivate}).kind == KeyKind::Unknown)
+            throw Key::Error("Can't open key file '" + src + "'. " + openError);
+        throw Key::Error(std::string(fromFile ? "File '" + src + "'" : "Key data") + " is neither public key nor certificate.");
     }
-    if (!key)
-        throw Key::Error("File '" + fileName + "' is neither public key (" + pkError + ") nor certificate (" + OPENSSLError() + ").");
-    if (EVP_PKEY_is_a(key.get(), type) == 0)
-        throw Key::Error("Expected " + std::string(type) + " key, got " + std::string(EVP_PKEY_get0_type_name(key.get())));
-    return key;
+    return checkKey(readKey(block.data, block.kind, Key::noPasswordCallback, context), kindName(block.kind), type);
+}
+
+Utils::EVPKeyPtr Utils::parseKey(std::string_view data, const Key::PasswordCallback& cb, const char* type, const Key::LibraryContext& context, bool& isPrivate)
+{
+    // A private key is preferred in bundles, it both signs and verifies.
+    const auto block = findBlock(data, {KeyKind::Private, KeyKind::EncryptedPrivate, KeyKind::Public, KeyKind::Certificate});
+    if (block.kind == KeyKind::Unknown)
+        throw Key::Error("Key data is neither private key, public key nor certificate in PEM or DER format.");
+    isPrivate = block.kind == KeyKind::Private || block.kind == KeyKind::EncryptedPrivate;
+    return checkKey(readKey(block.data, block.kind, cb, context), kindName(block.kind), type);
+}
+
+
+Utils::PooledMDCTX::PooledMDCTX()
+{
+    auto& pool = mdCtxPool();
+    if (!pool.empty())
+    {
+        m_ctx = std::move(pool.back());
+        pool.pop_back();
+    }
+    else
+        m_ctx.reset(EVP_MD_CTX_create());
+    if (!m_ctx)
+        throw Key::Error("Can't create message digest context. " + OPENSSLError());
+}
+
+Utils::PooledMDCTX::~PooledMDCTX()
+{
+    // Drop references to keys and digests, the context may outlive them in the pool.
+    EVP_MD_CTX_reset(m_ctx.get());
+    try
+    {
+        mdCtxPool().push_back(std::move(m_ctx));
+    }
+    catch (...)
+    {
+        // The context is freed if it can't be pooled.
+    }
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+Utils::EVPMACPtr Utils::fetchHMAC(const Key::LibraryContext& context)
+{
+    if (context.libCtx == nullptr && context.propertyQuery.empty())
+    {
+        // Never freed: keys may be destroyed after static objects.
+        static EVP_MAC* const hmac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+        if (hmac != nullptr && EVP_MAC_up_ref(hmac) == 1)
+            return EVPMACPtr(hmac);
+    }
+    return EVPMACPtr(EVP_MAC_fetch(context.libCtx, "HMAC", propertyQuery(context)));
+}
+#endif
+
+std::string Utils::readKeyFile(const std::string& fileName)
+{
+    std::string res;
+    if (!readFile(fileName, res))
+        throw Key::Error("Can't open key file '" + fileName + "'. " + sysError());
+    return res;
 }
 
 std::string Utils::OPENSSLError() noexcept
@@ -151,21 +453,6 @@ std::string Utils::OPENSSLError() noexcept
     return buf.data();
 }
 
-Utils::Triple Utils::split(const std::string& token)
-{
-    auto pos = token.find_first_of('.');
-    if (pos == std::string::npos)
-        throw JWT::ParseError("JWT should have at least 2 parts separated by a dot.");
-    auto spos = token.find_first_of('.', pos + 1);
-    if (spos == std::string::npos)
-        return std::make_tuple(token.substr(0, pos),
-                               token.substr(pos + 1, token.length() - pos - 1),
-                               "");
-    return std::make_tuple(token.substr(0, pos),
-                           token.substr(pos + 1, spos - pos - 1),
-                           token.substr(spos + 1, token.length() - spos - 1));
-}
-
 Utils::ECGroupPtr Utils::getECGroup(const EVPKeyPtr& keyPtr)
 {
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
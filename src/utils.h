@@ -3,11 +3,41 @@
 #include "jwtxx/jwt.h"
 
 #include <string>
+#include <string_view>
 #include <memory>
-#include <tuple>
 
 #include <openssl/evp.h>
 #include <openssl/ec.h> // EC_GROUP_*
+#include <openssl/opensslv.h> // OPENSSL_VERSION_NUMBER
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+#include <openssl/hmac.h>
+#endif
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+inline
+int EVP_MD_CTX_reset(EVP_MD_CTX* ctx)
+{
+    return EVP_MD_CTX_cleanup(ctx);
+}
+
+inline
+HMAC_CTX* HMAC_CTX_new()
+{
+    auto* ctx = static_cast<HMAC_CTX*>(OPENSSL_malloc(sizeof(HMAC_CTX)));
+    if (ctx != NULL)
+        HMAC_CTX_init(ctx);
+    return ctx;
+}
+
+inline
+void HMAC_CTX_free(HMAC_CTX* ctx)
+{
+    if (ctx == NULL)
+        return;
+    HMAC_CTX_cleanup(ctx);
+    OPENSSL_free(ctx);
+}
+#endif
 
 namespace JWTXX
 {
@@ -31,14 +61,64 @@ struct EVPMDCTXDeleter
 };
 using EVPMDCTXPtr = std::unique_ptr<EVP_MD_CTX, EVPMDCTXDeleter>;
 
-EVPKeyPtr readPEMPrivateKey(const std::string& fileName, const Key::PasswordCallback& cb, const char* type);
-EVPKeyPtr readPEMPublicKey(const std::string& fileName, const char* type);
+// Digest context borrowed from a per-thread pool and returned there in reset state.
+// Threads never share contexts, so no locking is needed.
+class PooledMDCTX
+{
+    public:
+        PooledMDCTX();
+        ~PooledMDCTX();
 
-std::string OPENSSLError() noexcept;
+        PooledMDCTX(const PooledMDCTX&) = delete;
+        PooledMDCTX& operator=(const PooledMDCTX&) = delete;
+
+        EVP_MD_CTX* get() const noexcept { return m_ctx.get(); }
+
+    private:
+        EVPMDCTXPtr m_ctx;
+};
 
-using Triple = std::tuple<std::string, std::string, std::string>;
+// Property query for OpenSSL *_ex functions, nullptr if there is none.
+inline
+const char* propertyQuery(const Key::LibraryContext& context) noexcept
+{
+    return context.propertyQuery.empty() ? nullptr : context.propertyQuery.c_str();
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+struct EVPMACDeleter
+{
+    void operator()(EVP_MAC* mac) const noexcept { EVP_MAC_free(mac); }
+};
+using EVPMACPtr = std::unique_ptr<EVP_MAC, EVPMACDeleter>;
+
+// HMAC implementation, fetched only once for the default library context.
+EVPMACPtr fetchHMAC(const Key::LibraryContext& context);
+
+struct EVPMACCTXDeleter
+{
+    void operator()(EVP_MAC_CTX* ctx) const noexcept { EVP_MAC_CTX_free(ctx); }
+};
+using EVPMACCTXPtr = std::unique_ptr<EVP_MAC_CTX, EVPMACCTXDeleter>;
+#else
+struct HMACCTXDeleter
+{
+    void operator()(HMAC_CTX* ctx) const noexcept { HMAC_CTX_free(ctx); }
+};
+using HMACCTXPtr = std::unique_ptr<HMAC_CTX, HMACCTXDeleter>;
+#endif
 
-Triple split(const std::string& token);
+// Keys and certificates are read in PEM or DER, the format and the kind of the key are recognized by the data itself.
+EVPKeyPtr readPrivateKey(const std::string& fileName, const Key::PasswordCallback& cb, const char* type, const Key::LibraryContext& context);
+// Reads a public key or a certificate from a file, or from 'src' itself if it is not a file name.
+EVPKeyPtr readPublicKey(const std::string& src, const char* type, const Key::LibraryContext& context);
+// Reads a private key, a public key or a certificate from memory, 'isPrivate' tells which one it was.
+EVPKeyPtr parseKey(std::string_view data, const Key::PasswordCallback& cb, const char* type, const Key::LibraryContext& context, bool& isPrivate);
+
+// Reads a whole file, e.g. a JWKS document.
+std::string readKeyFile(const std::string& fileName);
+
+std::string OPENSSLError() noexcept;
 
 struct ECGroupDeleter
 {
@@ -0,0 +1,155 @@
+#include "jwtxx/jwt.h"
+#include "jwtxx/cache.h"
+
+#include "initopenssl.h"
+
+#define BOOST_TEST_MODULE JWTCacheTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ctime>
+
+using JWTXX::Value;
+
+namespace
+{
+
+std::string makeToken(const JWTXX::Key& key, const std::string& subject, std::time_t exp)
+{
+    return JWTXX::JWT(key.alg(), {{"sub", Value(subject)}, {"exp", Value(static_cast<int64_t>(exp))}}).token(key);
+}
+
+}
+
+BOOST_GLOBAL_FIXTURE(InitOpenSSL);
+
+BOOST_AUTO_TEST_CASE(TestHitsAndMisses)
+{
+    const JWTXX::Key signKey(JWTXX::Algorithm::RS256, "rsa-2048-key-pair.pem");
+    const JWTXX::Key key(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem");
+    const JWTXX::Verifier verifier(key);
+    const auto token = makeToken(signKey, "user", std::time(nullptr) + 3600);
+
+    JWTXX::VerifiedTokenCache cache;
+    BOOST_CHECK(cache.verify(token, verifier));
+    BOOST_CHECK_EQUAL(cache.misses(), 1);
+    BOOST_CHECK_EQUAL(cache.hits(), 0);
+    BOOST_CHECK_EQUAL(cache.size(), 1);
+    BOOST_CHECK(cache.memoryUsage() > token.size());
+    for (size_t i = 0; i < 10; ++i)
+        BOOST_CHECK_EQUAL(cache.decode(token, verifier).claim("sub").getString(), "user");
+    BOOST_CHECK_EQUAL(cache.misses(), 1);
+    BOOST_CHECK_EQUAL(cache.hits(), 10);
+
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.size(), 0);
+    BOOST_CHECK_EQUAL(cache.memoryUsage(), 0);
+    BOOST_CHECK(cache.verify(token, verifier));
+    BOOST_CHECK_EQUAL(cache.misses(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestRejectedTokens)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const JWTXX::Verifier verifier(key);
+    JWTXX::VerifiedTokenCache cache;
+
+    auto token = makeToken(key, "user", std::time(nullptr) + 3600);
+    token.back() = token.back() == 'A' ? 'B' : 'A';
+    BOOST_CHECK(!cache.verify(token, verifier));
+    BOOST_CHECK_EQUAL(cache.verify(token, verifier).message(), "Signature is invalid.");
+    BOOST_CHECK_EQUAL(cache.size(), 0);
+
+    // Expired tokens are not cached.
+    const auto expired = makeToken(key, "user", std::time(nullptr) - 10);
+    BOOST_CHECK(!cache.verify(expired, verifier));
+    BOOST_CHECK_EQUAL(cache.size(), 0);
+
+    // Tokens without 'exp' are not cached either.
+    const auto eternal = JWTXX::JWT(key.alg(), {{"sub", Value("user")}}).token(key);
+    BOOST_CHECK(cache.verify(eternal, JWTXX::Verifier(key, {})));
+    BOOST_CHECK_EQUAL(cache.size(), 0);
+    BOOST_CHECK_EQUAL(cache.hits(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestValidatorsRunOnHits)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const auto token = makeToken(key, "user", std::time(nullptr) + 3600);
+    JWTXX::VerifiedTokenCache cache;
+
+    BOOST_CHECK(cache.verify(token, JWTXX::Verifier(key, {JWTXX::Validate::sub("user")})));
+    const auto res = cache.verify(token, JWTXX::Verifier(key, {JWTXX::Validate::sub("admin")}));
+    BOOST_CHECK(!res);
+    BOOST_CHECK_EQUAL(cache.hits(), 1);
+    BOOST_CHECK_THROW(cache.decode(token, JWTXX::Verifier(key, {JWTXX::Validate::sub("admin")})), JWTXX::JWT::ValidationError);
+}
+
+BOOST_AUTO_TEST_CASE(TestKeyIdentity)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const JWTXX::Key otherKey(JWTXX::Algorithm::HS256, "other-secret-key");
+    const auto token = makeToken(key, "user", std::time(nullptr) + 3600);
+    JWTXX::VerifiedTokenCache cache;
+
+    BOOST_CHECK(cache.verify(token, JWTXX::Verifier(key)));
+    // Cached for the first key only.
+    BOOST_CHECK(!cache.verify(token, JWTXX::Verifier(otherKey)));
+    BOOST_CHECK_EQUAL(cache.hits(), 0);
+    BOOST_CHECK_EQUAL(cache.misses(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestMemoryBudget)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const JWTXX::Verifier verifier(key);
+    constexpr size_t budget = 64 * 1024;
+    JWTXX::VerifiedTokenCache cache(budget, 4);
+
+    const auto exp = std::time(nullptr) + 3600;
+    for (size_t i = 0; i < 2000; ++i)
+        BOOST_REQUIRE(cache.verify(makeToken(key, "user" + std::to_string(i), exp), verifier));
+    BOOST_CHECK(cache.memoryUsage() <= budget);
+    BOOST_CHECK(cache.size() > 0);
+    BOOST_CHECK(cache.size() < 2000);
+
+    // The most recent token is still there.
+    const auto misses = cache.misses();
+    BOOST_CHECK(cache.verify(makeToken(key, "user1999", exp), verifier));
+    BOOST_CHECK_EQUAL(cache.misses(), misses);
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentAccess)
+{
+    const JWTXX::Key signKey(JWTXX::Algorithm::ES256, "ecdsa-256-key-pair.pem");
+    const JWTXX::Key key(JWTXX::Algorithm::ES256, "public-ecdsa-256-key.pem");
+    const JWTXX::Verifier verifier(key);
+    std::vector<std::string> tokens;
+    for (size_t i = 0; i < 32; ++i)
+        tokens.push_back(makeToken(signKey, "user" + std::to_string(i), std::time(nullptr) + 3600));
+
+    JWTXX::VerifiedTokenCache cache;
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 8; ++i)
+        threads.emplace_back([&, i]
+                             {
+                                 for (size_t j = 0; j < 500; ++j)
+                                 {
+                                     const auto n = (i + j) % tokens.size();
+                                     if (cache.decode(tokens[n], verifier).claim("sub").getString() != "user" + std::to_string(n))
+                                         ++failures;
+                                 }
+                             });
+    for (auto& thread : threads)
+        thread.join();
+    BOOST_CHECK_EQUAL(failures.load(), 0);
+    BOOST_CHECK_EQUAL(cache.hits() + cache.misses(), 8 * 500);
+    BOOST_CHECK(cache.misses() < 8 * 32 + 1);
+    BOOST_CHECK_EQUAL(cache.size(), tokens.size());
+}
@@ -7,6 +7,15 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <memory>
+#include <string>
+#include <utility> // std::move
+
+#include <ctime>
+
+#include <openssl/crypto.h> // OSSL_LIB_CTX_*
+#include <openssl/opensslv.h> // OPENSSL_VERSION_NUMBER
+
 using JWTXX::Value;
 
 namespace
@@ -243,3 +252,249 @@ BOOST_AUTO_TEST_CASE(TestParserHeaderErrors)
     BOOST_CHECK(!JWTXX::JWT::verify(invalidHeaderToken, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key")));
     BOOST_CHECK_THROW(JWTXX::JWT(invalidHeaderToken, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key")), JWTXX::JWT::Error);
 }
+
+BOOST_AUTO_TEST_CASE(TestValidatorSet)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const auto claims = JWTXX::JWT::parse(tokenWithExp).claims();
+
+    BOOST_CHECK(JWTXX::ValidatorSet().validate(claims));
+    BOOST_CHECK(JWTXX::ValidatorSet().exp(1475246522).nbf(1475246522).iat(1475246522).iss("madf").sub("user").aud("api").validate(claims)); // Audience is missing in the token
+    // Failures are reported in the same way as by the functions in Validate.
+    const auto same = [&](const JWTXX::ValidatorSet& set, const JWTXX::Validator& validator)
+                      {
+                          const auto res = set.validate(claims);
+                          const auto expected = validator(claims);
+                          BOOST_CHECK(!res);
+                          BOOST_CHECK(res.code() == expected.code());
+                          BOOST_CHECK_EQUAL(res.message(), expected.message());
+                      };
+    same(JWTXX::ValidatorSet().exp(1475246524), JWTXX::Validate::exp(1475246524));
+    same(JWTXX::ValidatorSet().nbf(1475242922), JWTXX::Validate::nbf(1475242922));
+    same(JWTXX::ValidatorSet().iat(1475242922), JWTXX::Validate::iat(1475242922));
+    same(JWTXX::ValidatorSet().iss("somebody"), JWTXX::Validate::iss("somebody"));
+    same(JWTXX::ValidatorSet().sub("someone"), JWTXX::Validate::sub("someone"));
+    // Fixed order: 'exp' is checked before 'iss'.
+    same(JWTXX::ValidatorSet().iss("somebody").exp(1475246524), JWTXX::Validate::exp(1475246524));
+    // The token has expired long ago.
+    BOOST_CHECK(!JWTXX::ValidatorSet().exp().validate(claims));
+    BOOST_CHECK(!JWTXX::ValidatorSet::defaults().validate(claims));
+    BOOST_CHECK(JWTXX::ValidatorSet().nbf().iat().validate(claims));
+
+    // Custom validators run after the standard checks.
+    size_t calls = 0;
+    auto custom = JWTXX::ValidatorSet().iss("madf").add([&](const Value::Object& c) { ++calls; return c.count("sub") ? JWTXX::ValidationResult::ok() : JWTXX::ValidationResult::failure("No subject."); });
+    BOOST_CHECK(custom.validate(claims));
+    BOOST_CHECK(!custom.validate({{"iss", Value("madf")}}));
+    BOOST_CHECK(!custom.iss("somebody").validate(claims));
+    BOOST_CHECK_EQUAL(calls, 2);
+
+    // Lists of validators convert implicitly.
+    const JWTXX::Validators list{JWTXX::Validate::exp(1475246522), JWTXX::Validate::iss("madf")};
+    BOOST_CHECK(JWTXX::JWT::verify(tokenWithExp, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key"), list));
+    const JWTXX::Verifier verifier(key, JWTXX::ValidatorSet().exp(1475246522).iss("madf"));
+    BOOST_CHECK(verifier.verify(tokenWithExp));
+    BOOST_CHECK(!JWTXX::Verifier(key, JWTXX::ValidatorSet().iss("somebody")).verify(tokenWithExp));
+}
+
+BOOST_AUTO_TEST_CASE(TestValidatorSetClock)
+{
+    // exp: 1475246523, nbf and iat: 1475242923
+    const auto claims = JWTXX::JWT::parse(tokenWithExp).claims();
+    std::time_t now = 1475246522;
+    size_t reads = 0;
+    const auto validators = JWTXX::ValidatorSet().exp().nbf().iat().clock([&] { ++reads; return now; });
+
+    BOOST_CHECK(validators.validate(claims));
+    BOOST_CHECK_EQUAL(reads, 1);
+    now = 1475246523;
+    const auto res = validators.validate(claims);
+    BOOST_CHECK(res.code() == JWTXX::ErrorCode::Expired);
+    BOOST_CHECK_EQUAL(res.message(), JWTXX::Validate::exp(now)(claims).message());
+    BOOST_CHECK_EQUAL(reads, 2);
+    // The clock isn't read if nothing depends on it.
+    BOOST_CHECK(JWTXX::ValidatorSet().exp().clock([&] { ++reads; return now; }).validate({}));
+    BOOST_CHECK_EQUAL(reads, 2);
+
+    // Leeway extends 'exp' and moves 'nbf' and 'iat' back.
+    auto lenient = JWTXX::ValidatorSet().exp().nbf().iat().clock([&] { return now; }).leeway(60);
+    BOOST_CHECK(lenient.validate(claims));
+    now = 1475246523 + 60;
+    BOOST_CHECK(!lenient.validate(claims));
+    now = 1475242923 - 59;
+    BOOST_CHECK(lenient.validate(claims));
+    now = 1475242923 - 60;
+    BOOST_CHECK(lenient.validate(claims).code() == JWTXX::ErrorCode::NotYetValid);
+    BOOST_CHECK(JWTXX::ValidatorSet().iat(1475242923 - 60).leeway(60).validate(claims).code() == JWTXX::ErrorCode::NotYetIssued);
+    BOOST_CHECK(JWTXX::ValidatorSet().exp(1475246523 + 59).leeway(60).validate(claims));
+
+    // The default clock.
+    const auto coarse = JWTXX::coarseTime();
+    BOOST_CHECK(coarse >= std::time(nullptr) - 1 && coarse <= std::time(nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(TestTryDecode)
+{
+    using JWTXX::ErrorCode;
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const JWTXX::Validators validators{JWTXX::Validate::exp(1475246522)};
+
+    const auto res = JWTXX::JWT::tryDecode(tokenWithExp, key, validators);
+    BOOST_REQUIRE(res);
+    BOOST_CHECK(res.code() == ErrorCode::Ok);
+    BOOST_CHECK(res.message().empty());
+    BOOST_CHECK_EQUAL(res.jwt().claim("sub").getString(), "user");
+
+    const auto check = [&](const char* token, ErrorCode code, const JWTXX::Validators& v)
+                       {
+                           const auto failure = JWTXX::JWT::tryDecode(token, key, v);
+                           BOOST_CHECK(!failure);
+                           BOOST_CHECK(failure.code() == code);
+                           // The same message as in exceptions.
+                           try
+                           {
+                               JWTXX::JWT(token, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key"), v);
+                               BOOST_ERROR("Exception expected");
+                           }
+                           catch (const JWTXX::JWT::Error& error)
+                           {
+                               BOOST_CHECK_EQUAL(failure.message(), error.what());
+                           }
+                           BOOST_CHECK_THROW(failure.jwt(), JWTXX::JWT::Error);
+                       };
+    check(notAToken2, ErrorCode::InvalidStructure, validators);
+    check("e*.e30.", ErrorCode::InvalidEncoding, validators);
+    check(brokenTokenWithExp1, ErrorCode::InvalidJSON, validators);
+    check(invalidHeaderToken, ErrorCode::InvalidAlgorithm, validators);
+    check(token512Order1, ErrorCode::AlgorithmMismatch, validators);
+    check(tokenCorruptedSign, ErrorCode::InvalidSignature, validators);
+    check(tokenWithExp, ErrorCode::Expired, {JWTXX::Validate::exp(1475246524)});
+    check(tokenWithExp, ErrorCode::NotYetValid, {JWTXX::Validate::nbf(1475242922)});
+    check(tokenWithExp, ErrorCode::NotYetIssued, {JWTXX::Validate::iat(1475242922)});
+    check(tokenWithExp, ErrorCode::InvalidClaim, {JWTXX::Validate::iss("somebody")});
+    check(tokenWithExp, ErrorCode::ValidationFailed, {[](const Value::Object&) { return JWTXX::ValidationResult::failure("Custom failure."); }});
+
+    BOOST_CHECK_THROW(JWTXX::JWT::tryDecode(notAToken2, key).jwt(), JWTXX::JWT::ParseError);
+    BOOST_CHECK_THROW(JWTXX::JWT::tryDecode(tokenCorruptedSign, key).jwt(), JWTXX::JWT::ValidationError);
+    BOOST_CHECK(JWTXX::JWT::verify(tokenCorruptedSign, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key")).code() == ErrorCode::InvalidSignature);
+
+    // Messages are formatted from the details of the failure on request, custom messages are kept as is.
+    BOOST_CHECK_EQUAL(JWTXX::JWT::tryDecode(tokenWithExp, key, JWTXX::ValidatorSet().exp(1475246524)).message(), "Token expired. Current time: '2016-09-30 14:42:04', expiration time: '2016-09-30 14:42:03'.");
+    BOOST_CHECK_EQUAL(JWTXX::JWT::tryDecode(tokenWithExp, key, JWTXX::ValidatorSet().iss("somebody")).message(), "'iss' claim should be 'somebody'. Got: \"madf\".");
+    BOOST_CHECK_EQUAL(JWTXX::ValidationResult::failure(ErrorCode::InvalidSignature, "Custom failure.").message(), "Custom failure.");
+
+    const JWTXX::Verifier verifier(key, validators);
+    auto decoded = verifier.tryDecode(tokenWithExp);
+    BOOST_REQUIRE(decoded);
+    const auto jwt = std::move(decoded).jwt();
+    BOOST_CHECK_EQUAL(jwt.header().at("alg").getString(), "HS256");
+    BOOST_CHECK(verifier.tryDecode(tokenCorruptedSign).code() == ErrorCode::InvalidSignature);
+    BOOST_CHECK(verifier.verify(token512Order1).code() == ErrorCode::AlgorithmMismatch);
+}
+
+BOOST_AUTO_TEST_CASE(TestTokenView)
+{
+    const std::string token(tokenWithExp);
+    const JWTXX::TokenView view(token);
+    BOOST_CHECK_EQUAL(view.header(), "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9");
+    BOOST_CHECK_EQUAL(view.signature(), "C2ifmz5X6Z_8HsPM-d_5pSFG03IUAB_6c1CTTrsPQtc");
+    BOOST_CHECK_EQUAL(view.signingInput().size(), view.header().size() + 1 + view.claims().size());
+    BOOST_CHECK(view.signingInput().data() == token.data());
+    BOOST_CHECK(JWTXX::JWT::verify(std::string_view(token), JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key"), {JWTXX::Validate::exp(1475246522)}));
+    BOOST_CHECK_THROW(JWTXX::TokenView("no-dots"), JWTXX::JWT::ParseError);
+    BOOST_CHECK(JWTXX::TokenView("a.b").signature().empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestLimits)
+{
+    using JWTXX::ErrorCode;
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+
+    // Size limits reject the token before it is decoded, even a malformed one.
+    JWTXX::Limits limits;
+    limits.maxTokenSize = 100;
+    const JWTXX::Verifier verifier(key, {}, JWTXX::ValidationOrder::SignatureFirst, limits);
+    BOOST_CHECK(verifier.tryDecode(std::string(101, '*')).code() == ErrorCode::LimitExceeded);
+    BOOST_CHECK_EQUAL(verifier.verify(std::string(101, '*')).message(), "Too long JWT: 101 bytes, the limit is 100.");
+    BOOST_CHECK(JWTXX::JWT::tryDecode(tokenWithExp, key, {}, limits).code() == ErrorCode::LimitExceeded);
+    BOOST_CHECK_THROW(JWTXX::JWT::parse(tokenWithExp, limits), JWTXX::JWT::ParseError);
+    limits.maxTokenSize = 1000;
+    limits.maxSegmentSize = 40;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(tokenWithExp, key, {}, limits).code() == ErrorCode::LimitExceeded);
+    BOOST_CHECK(JWTXX::JWT::tryDecode(std::string("e30.e30.") + std::string(41, 'A'), key, {}, limits).code() == ErrorCode::LimitExceeded);
+    limits.maxSegmentSize = 200;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(tokenWithExp, key, {}, limits));
+
+    // {"a":[1,2]} has 3 values, the header has 2.
+    const auto token = JWTXX::JWT(key.alg(), {{"a", Value(Value::Array{Value(static_cast<int64_t>(1)), Value(static_cast<int64_t>(2))})}}).token(key);
+    limits.maxMembers = 3;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(token, key, {}, limits));
+    limits.maxMembers = 2;
+    const auto tooMany = JWTXX::JWT::tryDecode(token, key, {}, limits);
+    BOOST_CHECK(tooMany.code() == ErrorCode::LimitExceeded);
+    BOOST_CHECK_EQUAL(tooMany.message(), "Can't decode JWT claims, JSON has more than 2 values.");
+    limits.maxMembers = 3;
+    limits.maxDepth = 1;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(token, key, {}, limits).code() == ErrorCode::LimitExceeded);
+    limits.maxDepth = 2;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(token, key, {}, limits));
+
+    // The defaults reject deep nesting and huge claim sets.
+    Value nested(static_cast<int64_t>(1));
+    for (size_t i = 0; i < 100; ++i)
+        nested = Value(Value::Array{nested});
+    const auto deep = JWTXX::JWT(key.alg(), {{"a", nested}}).token(key);
+    BOOST_CHECK(JWTXX::JWT::tryDecode(deep, key, {}).code() == ErrorCode::LimitExceeded);
+    BOOST_CHECK_THROW(JWTXX::JWT(deep, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key"), {}), JWTXX::JWT::ParseError);
+    limits = JWTXX::Limits{};
+    limits.maxDepth = 200;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(deep, key, {}, limits));
+
+    Value::Object claims;
+    for (size_t i = 0; i < 2000; ++i)
+        claims.emplace("c" + std::to_string(i), Value(static_cast<int64_t>(1)));
+    const auto wide = JWTXX::JWT(key.alg(), claims).token(key);
+    BOOST_CHECK(JWTXX::JWT::verify(wide, JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key"), {}).code() == ErrorCode::LimitExceeded);
+    limits.maxMembers = 2000;
+    BOOST_CHECK(JWTXX::JWT::tryDecode(wide, key, {}, limits));
+}
+
+BOOST_AUTO_TEST_CASE(TestKeyReuse)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const auto first = key.sign("data", 4);
+    for (size_t i = 0; i < 10; ++i)
+    {
+        BOOST_CHECK_EQUAL(key.sign("data", 4), first);
+        BOOST_CHECK(key.verify("data", 4, first));
+        BOOST_CHECK(!key.verify("date", 4, first));
+    }
+
+    const JWTXX::Key emptyKey(JWTXX::Algorithm::HS256, "");
+    BOOST_CHECK(emptyKey.verify("data", 4, emptyKey.sign("data", 4)));
+    BOOST_CHECK(!key.verify("data", 4, emptyKey.sign("data", 4)));
+}
+
+BOOST_AUTO_TEST_CASE(TestVerifyMalformedSignature)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    const auto signature = key.sign("data", 4);
+    BOOST_CHECK(key.verify("data", 4, signature));
+    BOOST_CHECK(!key.verify("data", 4, signature + "="));
+    BOOST_CHECK(!key.verify("data", 4, signature.substr(0, signature.size() - 1)));
+    BOOST_CHECK(!key.verify("data", 4, signature.substr(0, signature.size() - 1) + "*"));
+    BOOST_CHECK(!key.verify("data", 4, ""));
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+BOOST_AUTO_TEST_CASE(TestLibraryContext)
+{
+    std::unique_ptr<OSSL_LIB_CTX, decltype(&OSSL_LIB_CTX_free)> libCtx(OSSL_LIB_CTX_new(), OSSL_LIB_CTX_free);
+    BOOST_REQUIRE(libCtx);
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key", JWTXX::Key::LibraryContext{libCtx.get(), "provider=default"});
+    const JWTXX::Key defaultKey(JWTXX::Algorithm::HS256, "secret-key");
+    BOOST_CHECK_EQUAL(key.sign("data", 4), defaultKey.sign("data", 4));
+    BOOST_CHECK(key.verify("data", 4, defaultKey.sign("data", 4)));
+    BOOST_CHECK_THROW(JWTXX::Key(JWTXX::Algorithm::HS256, "secret-key", JWTXX::Key::LibraryContext{libCtx.get(), "provider=nonexistent"}), JWTXX::Key::Error);
+}
+#endif
@@ -0,0 +1,143 @@
+#include "jwtxx/jwt.h"
+#include "jwtxx/keyregistry.h"
+
+#include "initopenssl.h"
+
+#define BOOST_TEST_MODULE JWTKeyRegistryTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using JWTXX::Algorithm;
+using JWTXX::ErrorCode;
+using JWTXX::Key;
+using JWTXX::Value;
+
+namespace
+{
+
+std::string makeToken(Algorithm alg, const std::string& keyData, const std::string& kid)
+{
+    return JWTXX::JWT(alg, {{"sub", Value("user")}}, {{"kid", Value(kid)}}).token(keyData);
+}
+
+}
+
+BOOST_GLOBAL_FIXTURE(InitOpenSSL);
+
+BOOST_AUTO_TEST_CASE(TestAllowList)
+{
+    const JWTXX::KeyRegistry all;
+    BOOST_CHECK(all.allows(Algorithm::HS256));
+    BOOST_CHECK(all.allows(Algorithm::RS512));
+    BOOST_CHECK(all.allows(Algorithm::ES384));
+    BOOST_CHECK(!all.allows(Algorithm::none));
+
+    JWTXX::KeyRegistry keys({Algorithm::RS256, Algorithm::ES256});
+    BOOST_CHECK(keys.allows(Algorithm::RS256));
+    BOOST_CHECK(!keys.allows(Algorithm::HS256));
+    BOOST_CHECK_THROW(keys.add("hmac", Key(Algorithm::HS256, "secret-key")), Key::Error);
+    BOOST_CHECK_EQUAL(keys.size(), 0);
+
+    keys.add("rsa", Key(Algorithm::RS256, "public-rsa-2048-key.pem"));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "rsa"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "secret-key", "rsa"), keys).code() == ErrorCode::AlgorithmNotAllowed);
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::none, {}, {{"kid", Value("rsa")}}).token(""), keys).code() == ErrorCode::AlgorithmNotAllowed);
+}
+
+BOOST_AUTO_TEST_CASE(TestDispatch)
+{
+    JWTXX::KeyRegistry keys;
+    keys.add("1", Key(Algorithm::HS256, "secret-key"));
+    keys.add("1", Key(Algorithm::RS256, "public-rsa-2048-key.pem"));
+    keys.add("1", Key(Algorithm::ES256, "public-ecdsa-256-key.pem"));
+    keys.add("", Key(Algorithm::HS512, "other-key"));
+    BOOST_CHECK_EQUAL(keys.size(), 4);
+
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "secret-key", "1"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "1"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::ES256, "ecdsa-256-key-pair.pem", "1"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::HS512, {}).token("other-key"), keys));
+
+    const auto res = JWTXX::JWT::tryDecode(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "1"), keys);
+    BOOST_REQUIRE(res);
+    BOOST_CHECK_EQUAL(res.jwt().claim("sub").getString(), "user");
+
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS384, "rsa-2048-key-pair.pem", "1"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "secret-key", "2"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "other-key", "1"), keys).code() == ErrorCode::InvalidSignature);
+
+    const auto key = keys.find("1", Algorithm::ES256);
+    BOOST_REQUIRE(key);
+    BOOST_CHECK(key->alg() == Algorithm::ES256);
+    BOOST_CHECK(!keys.find("1", Algorithm::ES384));
+    BOOST_CHECK(!keys.find("2", Algorithm::ES256));
+}
+
+BOOST_AUTO_TEST_CASE(TestAddRemove)
+{
+    JWTXX::KeyRegistry keys;
+    keys.add("1", Key(Algorithm::HS256, "secret-key"));
+    keys.add("1", Key(Algorithm::RS256, "public-rsa-2048-key.pem"));
+    const auto token = makeToken(Algorithm::HS256, "secret-key", "1");
+    std::thread remover;
+    {
+        // A lease outlives the removal of its key.
+        const auto key = keys.find("1", Algorithm::HS256);
+        BOOST_REQUIRE(key);
+        remover = std::thread([&] { keys.remove("1", Algorithm::HS256); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        BOOST_CHECK(JWTXX::JWT::tryDecode(token, *key));
+    }
+    remover.join();
+    BOOST_CHECK_EQUAL(keys.size(), 1);
+    BOOST_CHECK(!keys.remove("1", Algorithm::HS256));
+    BOOST_CHECK(JWTXX::JWT::verify(token, keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "1"), keys));
+
+    // Replaced.
+    keys.add("1", Key(Algorithm::RS256, "public-rsa-2048-key.pem"));
+    BOOST_CHECK_EQUAL(keys.size(), 1);
+    BOOST_CHECK(keys.remove("1", Algorithm::RS256));
+    BOOST_CHECK_EQUAL(keys.size(), 0);
+    BOOST_CHECK(!keys.remove("1", Algorithm::RS256));
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentChanges)
+{
+    JWTXX::KeyRegistry keys;
+    keys.add("stable", Key(Algorithm::HS256, "secret-key"));
+    const auto stable = makeToken(Algorithm::HS256, "secret-key", "stable");
+    const auto rotated = makeToken(Algorithm::HS256, "secret-key", "rotated");
+
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> failures(0);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < 4; ++i)
+        readers.emplace_back([&]
+                             {
+                                 while (!stop)
+                                 {
+                                     if (!JWTXX::JWT::verify(stable, keys))
+                                         ++failures;
+                                     const auto res = JWTXX::JWT::verify(rotated, keys);
+                                     if (!res && res.code() != ErrorCode::UnknownKey)
+                                         ++failures;
+                                 }
+                             });
+    for (size_t i = 0; i < 200; ++i)
+    {
+        keys.add("rotated", Key(Algorithm::HS256, "secret-key"));
+        keys.remove("rotated", Algorithm::HS256);
+    }
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+    BOOST_CHECK_EQUAL(failures, 0);
+    BOOST_CHECK_EQUAL(keys.size(), 1);
+}
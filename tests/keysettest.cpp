@@ -0,0 +1,141 @@
+#include "jwtxx/jwt.h"
+#include "jwtxx/keyset.h"
+
+#include "initopenssl.h"
+
+#define BOOST_TEST_MODULE JWTKeySetTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using JWTXX::Algorithm;
+using JWTXX::ErrorCode;
+using JWTXX::Value;
+
+namespace
+{
+
+// public-rsa-2048-key.pem, public-ecdsa-256-key.pem and "secret-key".
+const std::string rsaJWK = R"({"kty": "RSA", "kid": "rsa", "use": "sig", "e": "AQAB", "n": "wGvWFyzOxi1uckHS7QvaVnOaqUEtIgrljEh62Z4dTrCVy7bH1LpR8sKKuWao-6JrpbzsqqYe0JQkEn1B5PzkwY3T_5kve6FwoOjZZxwEj1fsB4Pf0st4XOT_2KCoMBF17WZwMfkiCDIzoaNCMipKholzOrW_foAFmHtnTehrrKb_7WGQ22a9hhiPdVBZLVLX-b7x9czotGn7u2nRqx65LIpEljAIQoXl23g36gyZ7gk2G---I25z9meh4ZNY9rd6rWTD8ZojhYcmGCnKdufNyuzw6USToI18q218zDmkxxCEnGFrfmYE89l960HD7bQ4POFRZ4087HUMk5mVGCjWXQ"})";
+const std::string ecJWK = R"({"kty": "EC", "kid": "ec", "crv": "P-256", "x": "yeJHlnlG6exAXB7XLRqVNI9YHfe4LNq1_FsrfFSsknI", "y": "Hv2tY_WedMZ76pE0HLAfpkcym_JUMp0aV7yh27KApk8"})";
+const std::string octJWK = R"({"kty": "oct", "kid": "hmac", "alg": "HS256", "k": "c2VjcmV0LWtleQ"})";
+
+const std::string jwks = R"({"keys": [)" + rsaJWK + ", " + ecJWK + ", " + octJWK + R"(, {"kty": "RSA", "kid": "enc", "use": "enc", "e": "AQAB", "n": "AQAB"}, {"kty": "OKP", "kid": "ed", "crv": "Ed25519", "x": "AQAB"}]})";
+
+std::string makeToken(Algorithm alg, const std::string& keyData, const std::string& kid)
+{
+    return JWTXX::JWT(alg, {{"sub", Value("user")}}, {{"kid", Value(kid)}}).token(keyData);
+}
+
+}
+
+BOOST_GLOBAL_FIXTURE(InitOpenSSL);
+
+BOOST_AUTO_TEST_CASE(TestParsing)
+{
+    const JWTXX::KeySet keys(jwks);
+    BOOST_CHECK_EQUAL(keys.size(), 3);
+    BOOST_CHECK(keys.contains("rsa"));
+    BOOST_CHECK(keys.contains("ec"));
+    BOOST_CHECK(keys.contains("hmac"));
+    BOOST_CHECK(!keys.contains("enc"));
+    BOOST_CHECK(!keys.contains("ed"));
+    BOOST_CHECK(!keys.contains(""));
+
+    BOOST_CHECK_EQUAL(JWTXX::KeySet(octJWK).size(), 1);
+    BOOST_CHECK_EQUAL(JWTXX::KeySet(R"({"keys": []})").size(), 0);
+
+    BOOST_CHECK_THROW(JWTXX::KeySet("{\"keys\": "), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"keys": {}})"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"keys": [)" + octJWK + ", " + octJWK + "]}"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"keys": [{"kty": "oct", "k": "AQAB"}, {"kty": "oct", "alg": "HS384", "k": "AQAB"}]})"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"kty": "oct", "k": "!!!"})"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"kty": "RSA", "e": "AQAB"})"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"kty": "oct", "alg": "RS256", "k": "c2VjcmV0LWtleQ"})"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeySet(R"({"kty": "EC", "crv": "P-256", "x": "AQAB", "y": "AQAB"})"), JWTXX::Key::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestFind)
+{
+    const JWTXX::KeySet keys(jwks);
+    BOOST_CHECK(keys.find("nope", Algorithm::RS256) == nullptr);
+    BOOST_CHECK(keys.find("rsa", Algorithm::ES256) == nullptr);
+    BOOST_CHECK(keys.find("ec", Algorithm::ES384) == nullptr);
+    BOOST_CHECK(keys.find("hmac", Algorithm::HS512) == nullptr);
+    BOOST_CHECK(keys.find("rsa", Algorithm::none) == nullptr);
+
+    const auto* rsa = keys.find("rsa", Algorithm::RS256);
+    BOOST_REQUIRE(rsa != nullptr);
+    BOOST_CHECK(rsa->alg() == Algorithm::RS256);
+    // Created once.
+    BOOST_CHECK_EQUAL(keys.find("rsa", Algorithm::RS256), rsa);
+    const auto* rsa512 = keys.find("rsa", Algorithm::RS512);
+    BOOST_REQUIRE(rsa512 != nullptr);
+    BOOST_CHECK(rsa512 != rsa);
+    BOOST_CHECK(rsa512->alg() == Algorithm::RS512);
+
+    const auto* ec = keys.find("ec", Algorithm::ES256);
+    BOOST_REQUIRE(ec != nullptr);
+    BOOST_CHECK(ec->alg() == Algorithm::ES256);
+}
+
+BOOST_AUTO_TEST_CASE(TestVerify)
+{
+    const JWTXX::KeySet keys(jwks);
+
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "rsa"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS384, "rsa-2048-key-pair.pem", "rsa"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::ES256, "ecdsa-256-key-pair.pem", "ec"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "secret-key", "hmac"), keys));
+
+    const auto res = JWTXX::JWT::tryDecode(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "rsa"), keys);
+    BOOST_REQUIRE(res);
+    BOOST_CHECK_EQUAL(res.jwt().claim("sub").getString(), "user");
+
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "ec"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "secret-key", "nope"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "other-key", "hmac"), keys).code() == ErrorCode::InvalidSignature);
+    BOOST_CHECK(JWTXX::JWT::tryDecode(JWTXX::JWT(Algorithm::HS256, {{"sub", Value("user")}}).token("secret-key"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::none, {}, {{"kid", Value("rsa")}}).token(""), keys).code() == ErrorCode::UnknownKey);
+
+    // A key without an id matches tokens without 'kid'.
+    const JWTXX::KeySet single(R"({"kty": "oct", "k": "c2VjcmV0LWtleQ"})");
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::HS512, {{"sub", Value("user")}}).token("secret-key"), single));
+}
+
+BOOST_AUTO_TEST_CASE(TestSharedIds)
+{
+    // Keys of different types or for different algorithms may share an id (RFC 7517, 4.5), keys without an id as well.
+    auto withKid = [](std::string jwk, const std::string& kid)
+                   {
+                       const auto pos = jwk.find("\"kid\": \"") + 8;
+                       return jwk.replace(pos, jwk.find('"', pos) - pos, kid);
+                   };
+    const JWTXX::KeySet keys(R"({"keys": [)" + withKid(rsaJWK, "shared") + ", " + withKid(ecJWK, "shared") + ", " +
+                             R"({"kty": "oct", "alg": "HS256", "k": "c2VjcmV0LWtleQ"}, {"kty": "oct", "alg": "HS512", "k": "b3RoZXIta2V5"}]})");
+    BOOST_CHECK_EQUAL(keys.size(), 4);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "shared"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::ES256, "ecdsa-256-key-pair.pem", "shared"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::HS256, "secret-key", "shared"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::HS256, {{"sub", Value("user")}}).token("secret-key"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::HS512, {{"sub", Value("user")}}).token("other-key"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(JWTXX::JWT(Algorithm::HS384, {{"sub", Value("user")}}).token("secret-key"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK_NO_THROW(warmUp(keys));
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentFirstUse)
+{
+    const JWTXX::KeySet keys(jwks);
+    const auto token = makeToken(Algorithm::ES256, "ecdsa-256-key-pair.pem", "ec");
+    std::vector<std::thread> threads;
+    std::vector<char> results(8, 0);
+    for (size_t i = 0; i < results.size(); ++i)
+        threads.emplace_back([&, i] { results[i] = static_cast<bool>(JWTXX::JWT::verify(token, keys)); });
+    for (auto& thread : threads)
+        thread.join();
+    for (const auto result : results)
+        BOOST_CHECK(result);
+}
@@ -0,0 +1,174 @@
+#include "jwtxx/jwt.h"
+#include "jwtxx/keystore.h"
+
+#include "initopenssl.h"
+
+#define BOOST_TEST_MODULE JWTKeyStoreTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio> // std::rename, std::remove
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdlib> // mkdtemp
+
+#include <unistd.h> // rmdir
+
+using JWTXX::Algorithm;
+using JWTXX::ErrorCode;
+using JWTXX::Value;
+
+namespace
+{
+
+struct TempDir
+{
+    TempDir()
+    {
+        char pattern[] = "/tmp/jwtxx-keystore-XXXXXX";
+        if (mkdtemp(pattern) != nullptr)
+            path = pattern;
+    }
+    ~TempDir()
+    {
+        for (const auto& file : files)
+            std::remove(file.c_str());
+        rmdir(path.c_str());
+    }
+
+    // Replaces the file at once, the way key files are usually rotated.
+    std::string write(const std::string& name, const std::string& data)
+    {
+        const auto fileName = path + "/" + name;
+        const auto tempName = fileName + ".tmp";
+        std::ofstream(tempName) << data;
+        std::rename(tempName.c_str(), fileName.c_str());
+        files.push_back(fileName);
+        return fileName;
+    }
+
+    std::string path;
+    std::vector<std::string> files;
+};
+
+std::string readFile(const std::string& fileName)
+{
+    std::ifstream stream(fileName);
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+std::string octJWKS(const std::string& kid, const std::string& k)
+{
+    return R"({"keys": [{"kty": "oct", "kid": ")" + kid + R"(", "k": ")" + k + R"("}]})";
+}
+
+std::string makeToken(Algorithm alg, const std::string& keyData, const std::string& kid)
+{
+    return JWTXX::JWT(alg, {{"sub", Value("user")}}, {{"kid", Value(kid)}}).token(keyData);
+}
+
+bool waitFor(const std::function<bool ()>& condition)
+{
+    for (size_t i = 0; i < 500; ++i)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+}
+
+BOOST_GLOBAL_FIXTURE(InitOpenSSL);
+
+BOOST_AUTO_TEST_CASE(TestKeyFiles)
+{
+    TempDir dir;
+    BOOST_REQUIRE(!dir.path.empty());
+    const auto rsaFile = dir.write("rsa.pem", readFile("public-rsa-2048-key.pem"));
+    const auto ecFile = dir.write("ec.pem", readFile("public-ecdsa-256-key.pem"));
+
+    JWTXX::KeyStore keys({{"1", Algorithm::RS256, rsaFile}, {"1", Algorithm::ES256, ecFile}, {"2", Algorithm::RS512, rsaFile}});
+    BOOST_CHECK_EQUAL(keys.generation(), 1);
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "1"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::ES256, "ecdsa-256-key-pair.pem", "1"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS512, "rsa-2048-key-pair.pem", "2"), keys));
+    BOOST_CHECK(JWTXX::JWT::verify(makeToken(Algorithm::RS256, "rsa-2048-key-pair.pem", "2"), keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(keys.find("1", Algorithm::ES256));
+    BOOST_CHECK(!keys.find("3", Algorithm::ES256));
+
+    keys.reload();
+    BOOST_CHECK_EQUAL(keys.generation(), 2);
+
+    BOOST_CHECK_THROW(JWTXX::KeyStore({{"1", Algorithm::HS256, rsaFile}}), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeyStore({{"1", Algorithm::RS256, dir.path + "/missing.pem"}}), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::KeyStore({{"1", Algorithm::RS256, rsaFile}, {"1", Algorithm::RS256, rsaFile}}), JWTXX::Key::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestRotation)
+{
+    TempDir dir;
+    BOOST_REQUIRE(!dir.path.empty());
+    const auto jwksFile = dir.write("jwks.json", octJWKS("1", "c2VjcmV0LWtleQ")); // "secret-key"
+
+    std::atomic<size_t> errors(0);
+    JWTXX::KeyStore keys(jwksFile, [&](const std::string&) { ++errors; });
+    const auto token1 = makeToken(Algorithm::HS256, "secret-key", "1");
+    const auto token2 = makeToken(Algorithm::HS256, "other-key", "2");
+    BOOST_CHECK(JWTXX::JWT::verify(token1, keys));
+    BOOST_CHECK(JWTXX::JWT::verify(token2, keys).code() == ErrorCode::UnknownKey);
+
+    dir.write("jwks.json", octJWKS("2", "b3RoZXIta2V5")); // "other-key"
+    BOOST_REQUIRE(waitFor([&] { return keys.generation() == 2; }));
+    BOOST_CHECK(JWTXX::JWT::verify(token1, keys).code() == ErrorCode::UnknownKey);
+    BOOST_CHECK(JWTXX::JWT::verify(token2, keys));
+
+    // A broken file doesn't replace the keys.
+    dir.write("jwks.json", "{\"keys\": [");
+    BOOST_REQUIRE(waitFor([&] { return errors > 0; }));
+    BOOST_CHECK_EQUAL(keys.generation(), 2);
+    BOOST_CHECK(JWTXX::JWT::verify(token2, keys));
+    BOOST_CHECK_THROW(keys.reload(), JWTXX::Key::Error);
+
+    // Other files are ignored.
+    dir.write("other.json", "{}");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    BOOST_CHECK_EQUAL(keys.generation(), 2);
+
+    BOOST_CHECK_THROW(JWTXX::KeyStore(dir.path + "/other.json"), JWTXX::Key::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestReloadUnderLoad)
+{
+    TempDir dir;
+    BOOST_REQUIRE(!dir.path.empty());
+    const auto jwksFile = dir.write("jwks.json", octJWKS("1", "c2VjcmV0LWtleQ"));
+    JWTXX::KeyStore keys(jwksFile);
+    const auto token = makeToken(Algorithm::HS256, "secret-key", "1");
+
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> failures(0);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < 4; ++i)
+        readers.emplace_back([&]
+                             {
+                                 while (!stop)
+                                     if (!JWTXX::JWT::verify(token, keys))
+                                         ++failures;
+                             });
+    for (size_t i = 0; i < 100; ++i)
+        keys.reload();
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+    BOOST_CHECK_EQUAL(failures, 0);
+    BOOST_CHECK(keys.generation() >= 101);
+}
@@ -6,6 +6,18 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <fstream>
+#include <iterator> // std::istreambuf_iterator
+#include <memory>
+#include <string>
+
+#include <cstdio> // std::remove
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
 using JWTXX::Value;
 
 namespace
@@ -16,6 +28,36 @@ constexpr auto ecKeyFile = "ecdsa-256-key-pair.pem";
 constexpr auto rsaPubKeyFile = "public-rsa-2048-key.pem";
 constexpr auto ecPubKeyFile = "public-ecdsa-256-key.pem";
 
+std::string readFile(const char* fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Converts PEM data to DER with an OpenSSL i2d_*_bio function.
+template <typename T, typename Read, typename Free, typename Write>
+std::string toDER(const std::string& pem, Read read, Free free, Write write)
+{
+    std::unique_ptr<BIO, decltype(&BIO_free)> in(BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())), BIO_free);
+    std::unique_ptr<T, Free> object(read(in.get(), nullptr, nullptr, nullptr), free);
+    BOOST_REQUIRE(object);
+    std::unique_ptr<BIO, decltype(&BIO_free)> out(BIO_new(BIO_s_mem()), BIO_free);
+    BOOST_REQUIRE(write(out.get(), object.get()) == 1);
+    char* data = nullptr;
+    const auto size = BIO_get_mem_data(out.get(), &data);
+    return std::string(data, size);
+}
+
+std::string privateKeyToDER(const std::string& pem, const char* password = nullptr)
+{
+    return toDER<EVP_PKEY>(pem, PEM_read_bio_PrivateKey, EVP_PKEY_free, [=](BIO* bio, EVP_PKEY* key)
+                                                                       {
+                                                                           // PKCS#8, encrypted if there is a password.
+                                                                           return i2d_PKCS8PrivateKey_bio(bio, key, password != nullptr ? EVP_aes_256_cbc() : nullptr,
+                                                                                                          nullptr, 0, nullptr, const_cast<char*>(password));
+                                                                       });
+}
+
 }
 
 BOOST_GLOBAL_FIXTURE(InitOpenSSL);
@@ -91,3 +133,109 @@ BOOST_AUTO_TEST_CASE(TestAlgorithmMismatchES256WithES384)
 
     BOOST_CHECK_THROW(jwt.token(key), JWTXX::JWT::Error);
 }
+
+BOOST_AUTO_TEST_CASE(TestEagerLoading)
+{
+    using Usage = JWTXX::Key::Usage;
+    // Broken keys are reported by the constructor.
+    BOOST_CHECK_THROW(JWTXX::Key(JWTXX::Algorithm::RS256, "nonexistent.pem", Usage::Signing), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key(JWTXX::Algorithm::RS256, ecPubKeyFile, Usage::Verification), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key(JWTXX::Algorithm::ES256, rsaKeyFile, Usage::Signing), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key(JWTXX::Algorithm::ES256, ecPubKeyFile, Usage::Signing), JWTXX::Key::Error);
+    BOOST_CHECK_NO_THROW(JWTXX::Key(JWTXX::Algorithm::RS256, "nonexistent.pem"));
+
+    const JWTXX::Key rsaKey(JWTXX::Algorithm::RS256, rsaKeyFile, Usage::Signing);
+    const JWTXX::Key rsaPubKey(JWTXX::Algorithm::RS256, rsaPubKeyFile, Usage::Verification);
+    const JWTXX::Key ecKey(JWTXX::Algorithm::ES256, ecKeyFile, Usage::Signing);
+    const JWTXX::Key ecPubKey(JWTXX::Algorithm::ES256, ecPubKeyFile);
+    const JWTXX::Key hmacKey(JWTXX::Algorithm::HS256, "secret-key");
+    const JWTXX::Key noneKey(JWTXX::Algorithm::none, "");
+    BOOST_CHECK_NO_THROW(JWTXX::warmUp(rsaKey, rsaPubKey, ecKey, ecPubKey, hmacKey, noneKey));
+
+    const auto rsaToken = JWTXX::JWT(rsaKey.alg(), {{"sub", Value("test")}}).token(rsaKey);
+    BOOST_CHECK(JWTXX::Verifier(rsaPubKey, {}).verify(rsaToken));
+    const auto ecToken = JWTXX::JWT(ecKey.alg(), {{"sub", Value("test")}}).token(ecKey);
+    BOOST_CHECK(JWTXX::Verifier(ecPubKey, {}).verify(ecToken));
+
+    // Without a usage keys are warmed up for verification.
+    BOOST_CHECK_THROW(JWTXX::warmUp(JWTXX::Key(JWTXX::Algorithm::ES256, ecKeyFile)), JWTXX::Key::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestInMemoryKeys)
+{
+    const auto rsaPEM = readFile(rsaKeyFile);
+    const auto ecPEM = readFile(ecKeyFile);
+    const auto rsaPubPEM = readFile(rsaPubKeyFile);
+    const auto ecPubPEM = readFile(ecPubKeyFile);
+    const auto rsaCertPEM = readFile("rsa-cert.pem");
+    const auto rsaPubDER = toDER<EVP_PKEY>(rsaPubPEM, PEM_read_bio_PUBKEY, EVP_PKEY_free, i2d_PUBKEY_bio);
+    const auto rsaCertDER = toDER<X509>(rsaCertPEM, PEM_read_bio_X509, X509_free, i2d_X509_bio);
+    const auto rsaTraditionalDER = toDER<EVP_PKEY>(rsaPEM, PEM_read_bio_PrivateKey, EVP_PKEY_free, i2d_PrivateKey_bio);
+    const auto ecPubDER = toDER<EVP_PKEY>(ecPubPEM, PEM_read_bio_PUBKEY, EVP_PKEY_free, i2d_PUBKEY_bio);
+    const auto password = [] { return std::string("123456"); };
+
+    // Any private key signs, any public key, certificate or private key verifies.
+    const auto checkPair = [](const JWTXX::Key& signKey, const JWTXX::Key& verifyKey)
+                           {
+                               const auto token = JWTXX::JWT(signKey.alg(), {{"sub", Value("test")}}).token(signKey);
+                               BOOST_CHECK(JWTXX::Verifier(verifyKey, {}).verify(token));
+                           };
+    for (const auto& data : {rsaPEM, privateKeyToDER(rsaPEM), privateKeyToDER(rsaPEM, "123456"), rsaTraditionalDER, readFile("rsa-2048-key-pair-pw.pem")})
+    {
+        const auto key = JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, data, password);
+        checkPair(key, key);
+        for (const auto& pub : {rsaPubPEM, rsaPubDER, rsaCertPEM, rsaCertDER})
+            checkPair(key, JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, pub));
+        checkPair(key, JWTXX::Key(JWTXX::Algorithm::RS256, rsaPubKeyFile));
+    }
+    for (const auto& data : {ecPEM, privateKeyToDER(ecPEM), privateKeyToDER(ecPEM, "123456")})
+    {
+        const auto key = JWTXX::Key::fromMemory(JWTXX::Algorithm::ES256, data, password);
+        checkPair(key, key);
+        checkPair(key, JWTXX::Key::fromMemory(JWTXX::Algorithm::ES256, ecPubPEM));
+        checkPair(key, JWTXX::Key::fromMemory(JWTXX::Algorithm::ES256, ecPubDER));
+    }
+    // Public keys in DER work with file names and key data too.
+    checkPair(JWTXX::Key(JWTXX::Algorithm::ES256, ecKeyFile), JWTXX::Key(JWTXX::Algorithm::ES256, ecPubDER));
+    checkPair(JWTXX::Key(JWTXX::Algorithm::RS256, rsaKeyFile), JWTXX::Key(JWTXX::Algorithm::RS256, rsaCertPEM));
+
+    const auto hmacKey = JWTXX::Key::fromMemory(JWTXX::Algorithm::HS256, std::string("secret\0key", 10));
+    checkPair(hmacKey, hmacKey);
+
+    BOOST_CHECK_THROW(JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, "not a key"), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, rsaPubDER.substr(0, rsaPubDER.size() / 2)), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, ecPEM), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key::fromMemory(JWTXX::Algorithm::ES256, rsaCertDER), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, readFile("rsa-2048-key-pair-pw.pem")), JWTXX::Key::Error);
+    BOOST_CHECK_THROW(JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, rsaPubPEM).sign("data", 4), JWTXX::Key::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestKeyBundles)
+{
+    // Private keys bundled with their certificates or public keys, in either order.
+    const auto check = [](JWTXX::Algorithm alg, const std::string& first, const std::string& second)
+                       {
+                           const auto fileName = "bundle.pem";
+                           std::ofstream(fileName, std::ios::binary) << first << second;
+                           const JWTXX::Key signKey(alg, fileName, JWTXX::Key::Usage::Signing);
+                           const JWTXX::Key verifyKey(alg, fileName, JWTXX::Key::Usage::Verification);
+                           const auto token = JWTXX::JWT(alg, {{"sub", Value("test")}}).token(signKey);
+                           BOOST_CHECK(JWTXX::Verifier(verifyKey, {}).verify(token));
+                           std::remove(fileName);
+                       };
+    const auto rsaPEM = readFile(rsaKeyFile);
+    const auto rsaCertPEM = readFile("rsa-cert.pem");
+    const auto rsaPubPEM = readFile(rsaPubKeyFile);
+    const auto ecPEM = readFile(ecKeyFile);
+    const auto ecCertPEM = readFile("ecdsa-cert.pem");
+    check(JWTXX::Algorithm::RS256, rsaPEM, rsaCertPEM);
+    check(JWTXX::Algorithm::RS256, rsaCertPEM, rsaPEM);
+    check(JWTXX::Algorithm::RS256, rsaPEM, rsaPubPEM);
+    check(JWTXX::Algorithm::RS256, rsaPubPEM, rsaPEM);
+    check(JWTXX::Algorithm::ES256, ecPEM, ecCertPEM);
+    check(JWTXX::Algorithm::ES256, ecCertPEM, ecPEM);
+
+    // Bundles in memory prefer the private key.
+    const auto key = JWTXX::Key::fromMemory(JWTXX::Algorithm::RS256, rsaCertPEM + rsaPEM);
+    BOOST_CHECK(JWTXX::Verifier(key, {}).verify(JWTXX::JWT(key.alg(), {{"sub", Value("test")}}).token(key)));
+}
@@ -22,6 +22,11 @@ constexpr auto notAToken2 = "Hello, World!";
 constexpr auto invalidHeaderToken = "eyJhbGciOiJIUzI1NyIsInR5cCI6IkpXIn0.eyJuYW1lIjoiZm9vIn0";
 constexpr auto noTypToken = "eyJhbGciOiJub25lIn0.eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiYWRtaW4iOnRydWV9";
 constexpr auto wrongCaseTypToken = "eyJhbGciOiJub25lIiwidHlwIjoiald0In0.eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiYWRtaW4iOnRydWV9";
+constexpr auto claimTypesToken = "eyJhbGciOiJub25lIn0.eyJzIjoiY2Fmw6kg8J-YgFxuIiwiZSI6ImNhZlx1MDBlOSBcdWQ4M2RcdWRlMDBcbiIsIm4iOi0xMiwiZiI6Mi41LCJiIjpmYWxzZSwieiI6bnVsbCwiYSI6WzEsWzIseyJrIjoidiJ9XV0sIm8iOnsieCI6e319fQ";
+constexpr auto brokenJSONToken = "eyJhbGciOiJub25lIn0.eyJhIjpbMSwyfQ";
+constexpr auto underflowToken = "eyJhbGciOiJub25lIn0.eyJ1IjoxZS00MDAsIm0iOi0xZS00MDAsImQiOjQuOWUtMzI0fQ";
+constexpr auto overflowToken = "eyJhbGciOiJub25lIn0.eyJ4IjoxZTQwMH0";
+constexpr auto negativeOverflowToken = "eyJhbGciOiJub25lIn0.eyJ4IjotMWU0MDB9";
 constexpr auto nonJWTTypToken = "eyJhbGciOiJub25lIiwidHlwIjoiald0eHgifQ.eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiYWRtaW4iOnRydWV9";
 
 }
@@ -151,3 +156,36 @@ BOOST_AUTO_TEST_CASE(TestParserNonJWTTyp)
     BOOST_CHECK(JWTXX::JWT::verify(nonJWTTypToken, JWTXX::Key(JWTXX::Algorithm::none, "")));
     BOOST_CHECK_NO_THROW(JWTXX::JWT(nonJWTTypToken, JWTXX::Key(JWTXX::Algorithm::none, "")));
 }
+
+BOOST_AUTO_TEST_CASE(TestParserClaimTypes)
+{
+    const auto jwt = JWTXX::JWT::parse(claimTypesToken);
+    BOOST_CHECK_EQUAL(jwt.claim("s").getString(), "caf\xc3\xa9 \xf0\x9f\x98\x80\n");
+    BOOST_CHECK_EQUAL(jwt.claim("e").getString(), jwt.claim("s").getString());
+    BOOST_CHECK_EQUAL(jwt.claim("n").getInteger(), -12);
+    BOOST_CHECK_EQUAL(jwt.claim("f").toString(), "2.500000");
+    BOOST_CHECK_EQUAL(jwt.claim("b").getBool(), false);
+    BOOST_CHECK(jwt.claim("z").isNull());
+    BOOST_CHECK_EQUAL(jwt.claim("a").toString(), "[1,[2,{\"k\":\"v\"}]]");
+    BOOST_CHECK_EQUAL(jwt.claim("o").toString(), "{\"x\":{}}");
+    BOOST_CHECK_THROW(JWTXX::JWT::parse(brokenJSONToken), JWTXX::JWT::ParseError);
+
+    // Too small numbers round to zero, too big ones are rejected.
+    const auto tiny = JWTXX::JWT::parse(underflowToken);
+    BOOST_CHECK_EQUAL(tiny.claim("u").toString(), "0.000000");
+    BOOST_CHECK_EQUAL(tiny.claim("m").toString(), "-0.000000");
+    BOOST_CHECK_EQUAL(tiny.claim("d").toString(), "0.000000");
+    BOOST_CHECK_THROW(JWTXX::JWT::parse(overflowToken), JWTXX::JWT::ParseError);
+    BOOST_CHECK_THROW(JWTXX::JWT::parse(negativeOverflowToken), JWTXX::JWT::ParseError);
+}
+
+BOOST_AUTO_TEST_CASE(TestSerializerRoundTrip)
+{
+    const std::string text = "q\"b\\/\x01\t caf\xc3\xa9 \xf0\x9f\x98\x80";
+    JWTXX::JWT jwt(JWTXX::Algorithm::none, {{"s", Value(text)}, {"n", Value(static_cast<int64_t>(-12))}, {"f", Value::number(2.0)}, {"a", Value(Value::Array{Value(true), Value()})}});
+    const auto res = JWTXX::JWT::parse(jwt.token(""));
+    BOOST_CHECK_EQUAL(res.claim("s").getString(), text);
+    BOOST_CHECK_EQUAL(res.claim("n").getInteger(), -12);
+    BOOST_CHECK_EQUAL(res.claim("f").toString(), "2.000000");
+    BOOST_CHECK_EQUAL(res.claim("a").toString(), "[true,null]");
+}
@@ -7,6 +7,11 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <memory>
+
+#include <openssl/crypto.h> // OSSL_LIB_CTX_*
+#include <openssl/opensslv.h> // OPENSSL_VERSION_NUMBER
+
 using JWTXX::Value;
 
 namespace
@@ -303,6 +308,54 @@ BOOST_AUTO_TEST_CASE(TestVerifier)
     BOOST_CHECK(!JWTXX::JWT::verify(token512Order2, JWTXX::Key(JWTXX::Algorithm::RS512, "abc")));
 }
 
+BOOST_AUTO_TEST_CASE(TestReusableVerifier)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem");
+    const JWTXX::Verifier verifier(key, {JWTXX::Validate::exp(1475246522), JWTXX::Validate::iss("madf")});
+    for (size_t i = 0; i < 3; ++i)
+    {
+        BOOST_CHECK(verifier.verify(tokenWithExp));
+        BOOST_CHECK(!verifier.verify(tokenCorruptedSign));
+        BOOST_CHECK(!verifier.verify(token512Order1));
+    }
+    const auto jwt = verifier.decode(tokenWithExp);
+    BOOST_CHECK_EQUAL(jwt.claim("sub").getString(), "user");
+    BOOST_CHECK_EQUAL(jwt.header().at("alg").getString(), "RS256");
+    BOOST_CHECK_THROW(verifier.decode(notAToken2), JWTXX::JWT::ParseError);
+    BOOST_CHECK_THROW(verifier.decode(tokenCorruptedSign), JWTXX::JWT::ValidationError);
+
+    // Validates 'exp' using the current time, the token has expired long ago.
+    const JWTXX::Verifier shared(std::make_shared<const JWTXX::Key>(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem"));
+    BOOST_CHECK(shared.verify(token256Order1));
+    BOOST_CHECK(!shared.verify(tokenWithExp));
+
+    const JWTXX::Key missingKey(JWTXX::Algorithm::RS256, "no-such-key.pem");
+    BOOST_CHECK_THROW(JWTXX::Verifier{missingKey}, JWTXX::Key::Error);
+}
+
+BOOST_AUTO_TEST_CASE(TestValidationOrder)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem");
+    const JWTXX::Validators validators{JWTXX::Validate::exp()};
+
+    // The expired token with a corrupted signature is rejected by the cheaper check.
+    BOOST_CHECK_EQUAL(JWTXX::Verifier(key, validators).verify(tokenCorruptedSign).message(), "Signature is invalid.");
+    const JWTXX::Verifier claimsFirst(key, validators, JWTXX::ValidationOrder::ClaimsFirst);
+    BOOST_CHECK(claimsFirst.verify(tokenCorruptedSign).message().find("Token expired.") == 0);
+
+    // Claims that pass the validators are still not accepted without a valid signature.
+    const JWTXX::Verifier lenient(key, {JWTXX::Validate::exp(1475246522), JWTXX::Validate::iss("madf")}, JWTXX::ValidationOrder::ClaimsFirst);
+    BOOST_CHECK_EQUAL(lenient.verify(tokenCorruptedSign).message(), "Signature is invalid.");
+    BOOST_CHECK_THROW(lenient.decode(tokenCorruptedSign), JWTXX::JWT::ValidationError);
+    BOOST_CHECK(lenient.verify(tokenWithExp));
+    BOOST_CHECK_EQUAL(lenient.decode(tokenWithExp).claim("sub").getString(), "user");
+
+    // A missing signature is rejected before any validators run.
+    const std::string token(tokenWithExp);
+    const auto unsignedToken = token.substr(0, token.rfind('.'));
+    BOOST_CHECK_EQUAL(claimsFirst.verify(unsignedToken).message(), "Signature is invalid.");
+}
+
 BOOST_AUTO_TEST_CASE(TestParserNoVerify)
 {
     auto jwt = JWTXX::JWT::parse(tokenWithExp);
@@ -443,3 +496,20 @@ BOOST_AUTO_TEST_CASE(TestSelfValidation)
     BOOST_CHECK_EQUAL(header["typ"].getString(), "JWT");
     BOOST_CHECK_EQUAL(jwt.claim("iss").getString(), "madf");
 }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+BOOST_AUTO_TEST_CASE(TestLibraryContext)
+{
+    std::unique_ptr<OSSL_LIB_CTX, decltype(&OSSL_LIB_CTX_free)> libCtx(OSSL_LIB_CTX_new(), OSSL_LIB_CTX_free);
+    BOOST_REQUIRE(libCtx);
+    const JWTXX::Key::LibraryContext context{libCtx.get(), "provider=default"};
+    const JWTXX::Key signKey(JWTXX::Algorithm::RS256, "rsa-2048-key-pair.pem", context);
+    const JWTXX::Key verifyKey(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem", context);
+    const auto signature = signKey.sign("data", 4);
+    BOOST_CHECK(verifyKey.verify("data", 4, signature));
+    BOOST_CHECK(JWTXX::Key(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem").verify("data", 4, signature));
+
+    const JWTXX::Key missingProvider(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem", JWTXX::Key::LibraryContext{libCtx.get(), "provider=nonexistent"});
+    BOOST_CHECK_THROW(missingProvider.verify("data", 4, signature), JWTXX::Key::Error);
+}
+#endif
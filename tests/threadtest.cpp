@@ -0,0 +1,69 @@
+#include "jwtxx/jwt.h"
+
+#include "initopenssl.h"
+
+#define BOOST_TEST_MODULE JWTThreadTest
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t threadCount = 16;
+constexpr size_t iterations = 200;
+
+// Shares both keys between all threads, keys are fresh, so the first operations also race to load them.
+size_t stress(const JWTXX::Key& signKey, const JWTXX::Key& verifyKey)
+{
+    std::atomic<size_t> failures{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.emplace_back([&, i]
+                             {
+                                 while (!start)
+                                     std::this_thread::yield();
+                                 for (size_t j = 0; j < iterations; ++j)
+                                 {
+                                     const auto data = "thread " + std::to_string(i) + ", iteration " + std::to_string(j);
+                                     const auto signature = signKey.sign(data.data(), data.size());
+                                     if (!verifyKey.verify(data.data(), data.size(), signature))
+                                         ++failures;
+                                     if (verifyKey.verify(data.data(), data.size() - 1, signature))
+                                         ++failures;
+                                 }
+                             });
+    start = true;
+    for (auto& thread : threads)
+        thread.join();
+    return failures;
+}
+
+}
+
+BOOST_GLOBAL_FIXTURE(InitOpenSSL);
+
+BOOST_AUTO_TEST_CASE(TestSharedHMACKey)
+{
+    const JWTXX::Key key(JWTXX::Algorithm::HS256, "secret-key");
+    BOOST_CHECK_EQUAL(stress(key, key), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestSharedRSAKeys)
+{
+    const JWTXX::Key signKey(JWTXX::Algorithm::RS256, "rsa-2048-key-pair.pem");
+    const JWTXX::Key verifyKey(JWTXX::Algorithm::RS256, "public-rsa-2048-key.pem");
+    BOOST_CHECK_EQUAL(stress(signKey, verifyKey), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestSharedECKeys)
+{
+    const JWTXX::Key signKey(JWTXX::Algorithm::ES256, "ecdsa-256-key-pair.pem");
+    const JWTXX::Key verifyKey(JWTXX::Algorithm::ES256, "public-ecdsa-256-key.pem");
+    BOOST_CHECK_EQUAL(stress(signKey, verifyKey), 0);
+}
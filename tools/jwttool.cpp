@@ -3,12 +3,10 @@
 #include "jwtxx/value.h"
 #include "json.h"
 #include "base64url.h"
-#include "utils.h"
 
 #include <iostream>
 #include <string>
 #include <functional>
-#include <tuple> // std::get
 #include <utility> // std::pair<>::first, std::pair<>::second
 
 #include <jwtxx/jwt.h>
@@ -21,7 +19,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
-namespace Utils = JWTXX::Utils;
 using Value = JWTXX::Value;
 
 namespace
@@ -131,9 +128,9 @@ int print(JWTXX::Algorithm /*alg*/, const std::string& /*keyFile*/, const std::s
 {
     try
     {
-        auto parts = Utils::split(data);
-        const auto header = JWTXX::fromJSON(JWTXX::Base64URL::decode(std::get<0>(parts)).toString());
-        const auto claims = JWTXX::fromJSON(JWTXX::Base64URL::decode(std::get<1>(parts)).toString());
+        const JWTXX::TokenView view(data);
+        const auto header = JWTXX::fromJSON(JWTXX::Base64URL::decode(view.header()).toString());
+        const auto claims = JWTXX::fromJSON(JWTXX::Base64URL::decode(view.claims()).toString());
         printObject(header);
         std::cout << ".\n";
         printObject(claims);